@@ -118,6 +118,163 @@ static int atomic_cas(arch_atomic_t *v, int cmp_val, int new_val)
 
 #endif // PLF_ATOMIC_SUPPORTED
 
+/*
+ * Fetch-and-op family, all return the previous value:
+ *     atomic_<op>[_<order>](i, v), <op>: add, and, or, xor, min, max (signed)
+ *     atomic_xchg[_<order>](v, i)
+ *     atomic_cas[_<order>](v, cmp, new), returns non-zero on success
+ * <order> follows C11 memory orders and maps to AMO / LR/SC ordering bits:
+ *     _relaxed - none, _acquire - .aq, _release - .rl, _seq_cst - .aqrl
+ * Unsuffixed operations are relaxed.
+ * RV64: the same set for arch_atomic64_t as atomic64_*().
+ */
+
+// GEN(order, amo ordering, lr ordering, sc ordering, ...)
+#define ATOMIC_ORDERS(GEN, ...)                        \
+    GEN(_relaxed, "",      "",      "",    __VA_ARGS__) \
+    GEN(_acquire, ".aq",   ".aq",   "",    __VA_ARGS__) \
+    GEN(_release, ".rl",   "",      ".rl", __VA_ARGS__) \
+    GEN(_seq_cst, ".aqrl", ".aqrl", ".rl", __VA_ARGS__)
+
+#if PLF_ATOMIC_SUPPORTED
+
+#define ATOMIC_GEN_OP(order, amo_ord, lr_ord, sc_ord, pfx, atype, type, sfx, op, expr) \
+static inline type pfx##_##op##order(type i, atype *v)                  \
+{                                                                       \
+    type out;                                                           \
+                                                                        \
+    __asm__ __volatile__ (                                              \
+        "amo" #op "." sfx amo_ord " %1, %2, %0"                         \
+        : "+A" (v->counter), "=r" (out)                                 \
+        : "r" (i) : "memory");                                          \
+    return out;                                                         \
+}
+
+#define ATOMIC_GEN_XCHG(order, amo_ord, lr_ord, sc_ord, pfx, atype, type, sfx) \
+static inline type pfx##_xchg##order(atype *v, type i)                  \
+{                                                                       \
+    type out;                                                           \
+                                                                        \
+    __asm__ __volatile__ (                                              \
+        "amoswap." sfx amo_ord " %1, %2, %0"                            \
+        : "+A" (v->counter), "=r" (out)                                 \
+        : "r" (i) : "memory");                                          \
+    return out;                                                         \
+}
+
+#define ATOMIC_GEN_CAS(order, amo_ord, lr_ord, sc_ord, pfx, atype, type, sfx) \
+static inline int pfx##_cas##order(atype *v, type cmp_val, type new_val) \
+{                                                                       \
+    unsigned int rc;                                                    \
+    type ret;                                                           \
+                                                                        \
+    __asm__ __volatile__ (                                              \
+        "0: lr." sfx lr_ord " %0, %2\n"                                 \
+        "bne  %0, %3, 1f\n"                                             \
+        "sc." sfx sc_ord " %1, %4, %2\n"                                \
+        "bnez %1, 0b\n"                                                 \
+        "1:\n"                                                          \
+        : "=&r" (ret), "=&r" (rc), "+A" (v->counter)                    \
+        : "r" (cmp_val), "r" (new_val)                                  \
+        : "memory");                                                    \
+    return ret == cmp_val;                                              \
+}
+
+#else // PLF_ATOMIC_SUPPORTED
+
+// no AMO: plain read-modify-write, ordered variants are fenced on both sides
+#define ATOMIC_GEN_FENCE(amo_ord) \
+    do { if ((amo_ord)[0]) fence(); } while (0)
+
+#define ATOMIC_GEN_OP(order, amo_ord, lr_ord, sc_ord, pfx, atype, type, sfx, op, expr) \
+static inline type pfx##_##op##order(type i, atype *v)                  \
+{                                                                       \
+    ATOMIC_GEN_FENCE(amo_ord);                                          \
+    const type out = pfx##_read(v);                                     \
+    pfx##_set(v, (expr));                                               \
+    ATOMIC_GEN_FENCE(amo_ord);                                          \
+    return out;                                                         \
+}
+
+#define ATOMIC_GEN_XCHG(order, amo_ord, lr_ord, sc_ord, pfx, atype, type, sfx) \
+static inline type pfx##_xchg##order(atype *v, type i)                  \
+{                                                                       \
+    ATOMIC_GEN_FENCE(amo_ord);                                          \
+    const type out = pfx##_read(v);                                     \
+    pfx##_set(v, i);                                                    \
+    ATOMIC_GEN_FENCE(amo_ord);                                          \
+    return out;                                                         \
+}
+
+#define ATOMIC_GEN_CAS(order, amo_ord, lr_ord, sc_ord, pfx, atype, type, sfx) \
+static inline int pfx##_cas##order(atype *v, type cmp_val, type new_val) \
+{                                                                       \
+    ATOMIC_GEN_FENCE(amo_ord);                                          \
+    const int res = pfx##_read(v) == cmp_val;                           \
+    if (res)                                                            \
+        pfx##_set(v, new_val);                                          \
+    ATOMIC_GEN_FENCE(amo_ord);                                          \
+    return res;                                                         \
+}
+
+#endif // PLF_ATOMIC_SUPPORTED
+
+#define ATOMIC_GEN_ALL(pfx, atype, type, sfx)                                   \
+    ATOMIC_ORDERS(ATOMIC_GEN_OP, pfx, atype, type, sfx, add, out + i)           \
+    ATOMIC_ORDERS(ATOMIC_GEN_OP, pfx, atype, type, sfx, and, out & i)           \
+    ATOMIC_ORDERS(ATOMIC_GEN_OP, pfx, atype, type, sfx, or,  out | i)           \
+    ATOMIC_ORDERS(ATOMIC_GEN_OP, pfx, atype, type, sfx, xor, out ^ i)           \
+    ATOMIC_ORDERS(ATOMIC_GEN_OP, pfx, atype, type, sfx, min, (out < i) ? out : i) \
+    ATOMIC_ORDERS(ATOMIC_GEN_OP, pfx, atype, type, sfx, max, (out > i) ? out : i) \
+    ATOMIC_ORDERS(ATOMIC_GEN_XCHG, pfx, atype, type, sfx)                       \
+    ATOMIC_ORDERS(ATOMIC_GEN_CAS, pfx, atype, type, sfx)
+
+ATOMIC_GEN_ALL(atomic, arch_atomic_t, int, "w")
+
+#define atomic_and(i, v)  atomic_and_relaxed((i), (v))
+#define atomic_or(i, v)   atomic_or_relaxed((i), (v))
+#define atomic_xor(i, v)  atomic_xor_relaxed((i), (v))
+#define atomic_min(i, v)  atomic_min_relaxed((i), (v))
+#define atomic_max(i, v)  atomic_max_relaxed((i), (v))
+#define atomic_xchg(v, i) atomic_xchg_relaxed((v), (i))
+
+#if __riscv_xlen == 64
+
+typedef struct arch_atomic64 {
+    long counter;
+} arch_atomic64_t;
+
+#define ARCH_ATOMIC64_INIT(i) {(i)}
+
+static inline long atomic64_read(const arch_atomic64_t *v)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)&(v->counter), sizeof(v->counter));
+#endif // PLF_SMP_NON_COHERENT
+    return *((volatile long *)(&(v->counter)));
+}
+
+static inline void atomic64_set(arch_atomic64_t *v, long i)
+{
+    *((volatile long *)(&(v->counter))) = i;
+#if PLF_SMP_NON_COHERENT
+    cache_l1_flush((void*)&(v->counter), sizeof(v->counter));
+#endif // PLF_SMP_NON_COHERENT
+}
+
+ATOMIC_GEN_ALL(atomic64, arch_atomic64_t, long, "d")
+
+#define atomic64_add(i, v)  atomic64_add_relaxed((i), (v))
+#define atomic64_and(i, v)  atomic64_and_relaxed((i), (v))
+#define atomic64_or(i, v)   atomic64_or_relaxed((i), (v))
+#define atomic64_xor(i, v)  atomic64_xor_relaxed((i), (v))
+#define atomic64_min(i, v)  atomic64_min_relaxed((i), (v))
+#define atomic64_max(i, v)  atomic64_max_relaxed((i), (v))
+#define atomic64_xchg(v, i) atomic64_xchg_relaxed((v), (i))
+#define atomic64_cas(v, c, n) atomic64_cas_relaxed((v), (c), (n))
+
+#endif // __riscv_xlen == 64
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief hart barrier defs
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+#ifndef SCR_BSP_BARRIER_H
+#define SCR_BSP_BARRIER_H
+
+#include "arch.h"
+#include "atomic.h"
+#include "lock.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hart barriers.
+ * arch_barrier_t - centralized sense-reversing barrier: one shared arrival
+ * counter updated by AMO (by the generic lock without AMO), the last hart
+ * flips the release sense the others spin on.
+ * arch_dbarrier_t - dissemination barrier: ceil(log2(n)) rounds, in round k
+ * hart i signals hart (i + 2^k) mod n; every flag has a single writer and a
+ * single reader and lives in its own cache line, so there is no hot line and
+ * no AMO is required. The participants must be the harts 0 .. n-1
+ * (relative to PLF_SMP_HARTID_BASE).
+ * Both write back / invalidate their state on PLF_SMP_NON_COHERENT platforms
+ * and account the time every hart has spent waiting.
+ */
+#ifdef PLF_SMP_SUPPORT
+#define ARCH_BARRIER_HARTS PLF_SMP_HART_NUM
+#else
+#define ARCH_BARRIER_HARTS 1
+#endif // PLF_SMP_SUPPORT
+
+#ifdef PLF_MAX_CACHELINE_SIZE
+#define ARCH_BARRIER_ALIGN PLF_MAX_CACHELINE_SIZE
+#else
+#define ARCH_BARRIER_ALIGN 64
+#endif
+
+#define ARCH_BARRIER_LOG2_CEIL(n) \
+    ((n) <= 1 ? 0 : (n) <= 2 ? 1 : (n) <= 4 ? 2 : (n) <= 8 ? 3 : \
+     (n) <= 16 ? 4 : (n) <= 32 ? 5 : 6)
+
+#define ARCH_DBARRIER_ROUNDS (ARCH_BARRIER_LOG2_CEIL(ARCH_BARRIER_HARTS) ? ARCH_BARRIER_LOG2_CEIL(ARCH_BARRIER_HARTS) : 1)
+
+typedef struct arch_barrier_stat {
+    uint64_t wait_cycles;     // total cycles spent in the barrier
+    uint64_t max_wait_cycles; // longest single wait
+    unsigned long count;      // number of barrier episodes
+} arch_barrier_stat_t;
+
+// per-hart state, written by the owner hart only
+typedef struct arch_barrier_hart {
+    arch_barrier_stat_t stat;
+    unsigned long epoch;
+} __attribute__((aligned(ARCH_BARRIER_ALIGN))) arch_barrier_hart_t;
+
+typedef struct arch_barrier {
+    unsigned nharts;
+    struct {
+        arch_atomic_t count;
+#if defined(PLF_SMP_SUPPORT) && !PLF_ATOMIC_SUPPORTED
+        arch_lock_t lock;
+#endif
+    } __attribute__((aligned(ARCH_BARRIER_ALIGN))) arrive;
+    struct {
+        volatile int sense;
+    } __attribute__((aligned(ARCH_BARRIER_ALIGN))) release;
+    arch_barrier_hart_t hart[ARCH_BARRIER_HARTS];
+} arch_barrier_t;
+
+#define ARCH_BARRIER_INIT(n) { .nharts = (n) }
+
+typedef struct arch_dbarrier_flag {
+    volatile unsigned long epoch;
+} __attribute__((aligned(ARCH_BARRIER_ALIGN))) arch_dbarrier_flag_t;
+
+typedef struct arch_dbarrier {
+    unsigned nharts;
+    unsigned rounds;
+    arch_dbarrier_flag_t flag[ARCH_BARRIER_HARTS][ARCH_DBARRIER_ROUNDS];
+    arch_barrier_hart_t hart[ARCH_BARRIER_HARTS];
+} arch_dbarrier_t;
+
+#define ARCH_DBARRIER_INIT(n) { .nharts = (n), .rounds = ARCH_BARRIER_LOG2_CEIL(n) }
+
+// n: number of participating harts, 1 .. ARCH_BARRIER_HARTS (PLF_SMP_HART_NUM),
+// must not be called while the barrier is in use; returns 0 or -EINVAL
+// ARCH_BARRIER_INIT()/ARCH_DBARRIER_INIT() are not checked: n must be in the same range
+int arch_barrier_init(arch_barrier_t *b, unsigned nharts);
+void arch_barrier_wait(arch_barrier_t *b);
+void arch_barrier_get_stat(const arch_barrier_t *b, unsigned hart, arch_barrier_stat_t *stat);
+
+int arch_dbarrier_init(arch_dbarrier_t *b, unsigned nharts);
+void arch_dbarrier_wait(arch_dbarrier_t *b);
+void arch_dbarrier_get_stat(const arch_dbarrier_t *b, unsigned hart, arch_barrier_stat_t *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCR_BSP_BARRIER_H
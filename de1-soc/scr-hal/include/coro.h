@@ -0,0 +1,602 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Event-driven executor and C++ coroutines
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#ifndef SCR_BSP_CORO_H
+#define SCR_BSP_CORO_H
+
+#ifndef __cplusplus
+#error coro.h is a C++ header
+#endif
+
+#include "arch.h"
+#include "atomic.h"
+#include "hart_local.h"
+#include "ring.h"
+#include "drivers/console.h"
+#include "drivers/irq.h"
+#include "drivers/rtc.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if __cpp_impl_coroutine
+#include <coroutine>
+#define HAL_CORO_SUPPORTED 1
+#else
+#define HAL_CORO_SUPPORTED 0
+#endif // __cpp_impl_coroutine
+
+/*
+ * Per-hart event loop: waiters for the console UART, IRQ lines, mtimer deadlines
+ * and ring queue messages (e.g. from another hart) are completed by the hart that
+ * registered them. The executor polls the pending waiters, runs the completed ones
+ * and sleeps in WFI until an interrupt when there is nothing to run:
+ *  - IRQ: the line is enabled while awaited, the trap handler disables it and marks
+ *    the waiters; the awaiting code services the device, the next wait re-enables the line;
+ *  - mtimer: the hart's mtimecmp is set to the earliest deadline; with the single
+ *    SCR mtimer comparator (no PLF_MTIMER_EXT) only hart 0 takes the timers, on the
+ *    other harts wait_until() returns false and the polled waiters spin instead of WFI;
+ *  - ring queues: the hart sleeps as the consumer, the producer wakes it by IPI
+ *    (PLF_RING_WFI, the hart must call ipi_init());
+ *  - UART: the RX interrupt line given by executor::set_uart_irq(), otherwise the
+ *    UART is polled every PLF_CORO_POLL_TICKS.
+ * The executor owns the hart's mtimer interrupt. The application trap_handler() calls
+ * hal::co::trap_handler(mcause) after ipi_trap_handler(), or executor::irq_fired(line)
+ * from its own external interrupt dispatch.
+ *
+ * With coroutine support (C++20, or -fcoroutines: HAL_CXX_COROUTINES=ON) hal::co::task<T>
+ * coroutines await the events directly:
+ *     hal::co::task<> echo()
+ *     {
+ *         for (;;)
+ *             con_putc(co_await hal::co::uart_byte());
+ *     }
+ *     ...
+ *     hal::co::executor ex;
+ *     ex.spawn(echo());
+ *     ex.run();
+ * Without it the same waiters complete callbacks (waiter::fn).
+ * The executor and the waiters must be used by the owner hart only, not from the
+ * interrupt handlers.
+ */
+#ifndef PLF_CORO_POLL_TICKS
+#define PLF_CORO_POLL_TICKS PLF_US2TICKS(100)
+#endif
+
+#ifdef PLF_SMP_SUPPORT
+#define HAL_CORO_HARTS PLF_SMP_HART_NUM
+#else
+#define HAL_CORO_HARTS 1
+#endif // PLF_SMP_SUPPORT
+
+namespace hal {
+namespace co {
+
+#if HAL_CORO_SUPPORTED
+template <typename T> class task;
+#endif // HAL_CORO_SUPPORTED
+
+struct waiter {
+    enum kind_t { READY, UART, IRQ, TIMER, RING };
+
+    waiter *next = nullptr;
+    void (*fn)(waiter *w) = nullptr; // completion, called by the executor loop
+    kind_t kind = READY;
+    volatile bool fired = false;     // IRQ: set by the trap handler
+    int line = -1;                   // IRQ line
+    sys_tick_t deadline = 0;         // TIMER
+    void *ring = nullptr;            // RING
+    bool (*pop)(void *ring, void **item) = nullptr;
+    arch_atomic_t *sleepers = nullptr;
+    int value = -1;                  // UART: received byte
+    void *item = nullptr;            // RING: received message
+};
+
+class executor {
+public:
+    executor() { slot(hart_local_index()) = this; }
+    ~executor() { slot(hart_local_index()) = nullptr; }
+    executor(const executor&) = delete;
+    executor &operator=(const executor&) = delete;
+
+    // executor of the calling hart
+    static executor *current() { return slot(hart_local_index()); }
+
+    // the calling hart has its own mtimer comparator
+    static bool has_timer()
+    {
+#if defined(PLF_MTIMER_BASE) && !defined(PLF_MTIMER_EXT)
+        return hart_local_index() == 0;
+#else
+        return true;
+#endif
+    }
+
+    // console UART RX interrupt line, < 0: poll
+    void set_uart_irq(int line) { uart_irq_ = line; }
+
+    // run w.fn from the loop
+    void post(waiter &w)
+    {
+        w.kind = waiter::READY;
+        w.next = nullptr;
+        if (ready_tail_)
+            ready_tail_->next = &w;
+        else
+            ready_ = &w;
+        ready_tail_ = &w;
+    }
+
+    void wait_uart(waiter &w)
+    {
+        w.kind = waiter::UART;
+        add(w);
+    }
+
+    void wait_irq(waiter &w, int line)
+    {
+        w.kind = waiter::IRQ;
+        w.line = line;
+        w.fired = false;
+        add(w);
+    }
+
+    // returns false if the hart has no mtimer comparator, the waiter is not queued
+    bool wait_until(waiter &w, sys_tick_t deadline)
+    {
+        if (!has_timer())
+            return false;
+        w.kind = waiter::TIMER;
+        w.deadline = deadline;
+        add(w);
+        return true;
+    }
+
+    void wait_spsc(waiter &w, arch_spsc_ring_t &r)
+    {
+        w.kind = waiter::RING;
+        w.ring = &r;
+        w.pop = [](void *p, void **item) { return arch_spsc_pop((arch_spsc_ring_t*)p, item); };
+        w.sleepers = &r.sleepers.cons;
+        add(w);
+    }
+
+    void wait_mpmc(waiter &w, arch_mpmc_ring_t &r)
+    {
+        w.kind = waiter::RING;
+        w.ring = &r;
+        w.pop = [](void *p, void **item) { return arch_mpmc_pop((arch_mpmc_ring_t*)p, item); };
+        w.sleepers = &r.sleepers.cons;
+        add(w);
+    }
+
+    // complete the pending waiters and run the ready ones
+    // returns false if nothing is pending
+    bool poll()
+    {
+        const unsigned long mstatus = clear_csr(mstatus, MSTATUS_MIE);
+        collect();
+        set_csr(mstatus, mstatus & MSTATUS_MIE);
+
+        waiter *w = ready_;
+
+        ready_ = ready_tail_ = nullptr;
+        while (w) {
+            waiter *next = w->next; // fn may queue w again
+            w->fn(w);
+            w = next;
+        }
+
+        return waits_ || ready_;
+    }
+
+    // run until nothing is pending, sleep in WFI when idle
+    void run()
+    {
+        while (poll()) {
+            if (!ready_)
+                idle();
+        }
+    }
+
+    // trap handler: marks the waiters of the line and disables it
+    // returns true if the line is awaited on the hart
+    bool irq_fired(int line)
+    {
+        bool found = (line == uart_irq_);
+
+        for (waiter *w = waits_; w; w = w->next) {
+            if (w->kind == waiter::IRQ && w->line == line) {
+                w->fired = true;
+                found = true;
+            }
+        }
+        irq_disable(line);
+
+        return found;
+    }
+
+#if HAL_CORO_SUPPORTED
+    // start the task from the loop, its frame is freed when it finishes
+    template <typename T>
+    void spawn(task<T> &&t);
+#endif // HAL_CORO_SUPPORTED
+
+private:
+    static executor *&slot(unsigned hart)
+    {
+        static executor *executors[HAL_CORO_HARTS];
+        return executors[hart];
+    }
+
+    void add(waiter &w)
+    {
+        const unsigned long mstatus = clear_csr(mstatus, MSTATUS_MIE);
+        w.next = waits_;
+        waits_ = &w;
+        if (w.kind == waiter::IRQ)
+            irq_enable(w.line);
+        set_csr(mstatus, mstatus & MSTATUS_MIE);
+    }
+
+    static bool complete(waiter &w)
+    {
+        switch (w.kind) {
+        case waiter::UART:
+            w.value = con_getc_nowait();
+            return w.value >= 0;
+        case waiter::IRQ:
+            return w.fired;
+        case waiter::TIMER:
+            return rtc_now() >= w.deadline;
+        case waiter::RING:
+            return w.pop(w.ring, &w.item);
+        default:
+            return true;
+        }
+    }
+
+    // interrupts are disabled: move the completed waiters to the ready queue
+    bool collect()
+    {
+        bool any = false;
+
+        for (waiter **pw = &waits_; *pw;) {
+            waiter *w = *pw;
+
+            if (complete(*w)) {
+                *pw = w->next;
+                w->next = nullptr;
+                if (ready_tail_)
+                    ready_tail_->next = w;
+                else
+                    ready_ = w;
+                ready_tail_ = w;
+                any = true;
+            } else {
+                pw = &w->next;
+            }
+        }
+
+        return any;
+    }
+
+    void idle()
+    {
+        const unsigned long mstatus = clear_csr(mstatus, MSTATUS_MIE);
+#if PLF_RING_WFI
+        const int self = 1 << hart_local_index();
+#endif // PLF_RING_WFI
+        sys_tick_t wake = ~(sys_tick_t)0;
+        bool polled = false;
+        bool armed = true;
+
+        for (waiter *w = waits_; w; w = w->next) {
+            if (w->kind == waiter::TIMER && w->deadline < wake)
+                wake = w->deadline;
+            else if (w->kind == waiter::UART && uart_irq_ < 0)
+                polled = true;
+            else if (w->kind == waiter::UART)
+                irq_enable(uart_irq_);
+#if PLF_RING_WFI
+            else if (w->kind == waiter::RING)
+                atomic_or_seq_cst(self, w->sleepers); // pairs with fence() of arch_ring_wake()
+#else
+            else if (w->kind == waiter::RING)
+                polled = true;
+#endif // PLF_RING_WFI
+        }
+
+        if (polled && rtc_now() + PLF_CORO_POLL_TICKS < wake)
+            wake = rtc_now() + PLF_CORO_POLL_TICKS;
+        if (wake != ~(sys_tick_t)0) {
+            if (has_timer()) {
+                rtc_setcmp_hart(hart_local_index(), wake);
+                set_csr(mie, MIE_MTIMER);
+            } else {
+                // polled waiters only: nothing would wake the hart
+                armed = false;
+            }
+        }
+
+        // an event may have come after the last poll
+        if (!collect() && armed)
+            wfi();
+
+#if PLF_RING_WFI
+        for (waiter *w = waits_; w; w = w->next) {
+            if (w->kind == waiter::RING)
+                atomic_and(~self, w->sleepers);
+        }
+        // the completed ring waiters have left the list
+        for (waiter *w = ready_; w; w = w->next) {
+            if (w->kind == waiter::RING)
+                atomic_and(~self, w->sleepers);
+        }
+#endif // PLF_RING_WFI
+
+        // take the pending interrupts
+        set_csr(mstatus, mstatus & MSTATUS_MIE);
+    }
+
+    waiter *waits_ = nullptr;  // pending, changed with the interrupts disabled
+    waiter *ready_ = nullptr;
+    waiter *ready_tail_ = nullptr;
+    int uart_irq_ = -1;
+};
+
+// serves the mtimer and external interrupts for the executor of the hart
+// returns true if the trap is handled
+inline bool trap_handler(unsigned long mcause)
+{
+    executor *ex = executor::current();
+
+    if (!ex)
+        return false;
+
+    if (mcause == (TRAP_CAUSE_INTERRUPT_FLAG | TRAP_CAUSE_INT_MTIME)) {
+        // re-armed by the idle loop
+        clear_csr(mie, MIE_MTIMER);
+        return true;
+    }
+
+    if (mcause == (TRAP_CAUSE_INTERRUPT_FLAG | TRAP_CAUSE_INT_MEXT)) {
+        const int line = irq_soi();
+
+#ifdef IRQ_NONE
+        if (line == IRQ_NONE)
+            return true;
+#endif // IRQ_NONE
+        if (line >= 0) {
+            // not awaited lines stay disabled until awaited
+            (void)ex->irq_fired(line);
+            irq_eoi(line);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+#if HAL_CORO_SUPPORTED
+
+// waiter resuming a coroutine
+struct resume_waiter : waiter {
+    std::coroutine_handle<> handle;
+
+    resume_waiter() { fn = [](waiter *w) { static_cast<resume_waiter*>(w)->handle.resume(); }; }
+};
+
+namespace detail {
+
+struct promise_base {
+    std::coroutine_handle<> cont; // awaiting coroutine
+    bool detached = false;        // spawned: the frame is freed at the end
+    resume_waiter start;
+
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+        {
+            promise_base &p = h.promise();
+
+            if (p.cont)
+                return p.cont;
+            if (p.detached)
+                h.destroy();
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    final_awaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() noexcept { abort(); }
+
+    // coroutine frames are taken from the heap, out of memory aborts
+    static void *operator new(size_t size)
+    {
+        void *p = malloc(size);
+
+        if (!p)
+            abort();
+        return p;
+    }
+
+    static void operator delete(void *p) noexcept { free(p); }
+};
+
+template <typename T>
+struct promise_value {
+    T value{};
+
+    void return_value(T v) { value = static_cast<T&&>(v); }
+    T get() { return static_cast<T&&>(value); }
+};
+
+template <>
+struct promise_value<void> {
+    void return_void() noexcept {}
+    void get() noexcept {}
+};
+
+} // namespace detail
+
+// lazy coroutine: starts when awaited or spawned
+template <typename T = void>
+class task {
+public:
+    struct promise_type : detail::promise_base, detail::promise_value<T> {
+        task get_return_object() noexcept { return task(handle_t::from_promise(*this)); }
+    };
+
+    using handle_t = std::coroutine_handle<promise_type>;
+
+    task(task &&t) noexcept : h_(t.h_) { t.h_ = nullptr; }
+    task &operator=(task &&t) noexcept
+    {
+        if (this != &t) {
+            if (h_)
+                h_.destroy();
+            h_ = t.h_;
+            t.h_ = nullptr;
+        }
+        return *this;
+    }
+    task(const task&) = delete;
+    task &operator=(const task&) = delete;
+    ~task()
+    {
+        if (h_)
+            h_.destroy();
+    }
+
+    bool await_ready() const noexcept { return h_.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> c) noexcept
+    {
+        h_.promise().cont = c;
+        return h_;
+    }
+
+    T await_resume() { return h_.promise().get(); }
+
+    handle_t release() noexcept
+    {
+        handle_t h = h_;
+
+        h_ = nullptr;
+        return h;
+    }
+
+private:
+    explicit task(handle_t h) : h_(h) {}
+
+    handle_t h_;
+};
+
+template <typename T>
+void executor::spawn(task<T> &&t)
+{
+    auto h = t.release();
+
+    h.promise().detached = true;
+    h.promise().start.handle = h;
+    post(h.promise().start);
+}
+
+/// awaitables, resumed by the executor of the hart
+
+// next byte from the console UART
+struct uart_byte : resume_waiter {
+    bool await_ready() { value = con_getc_nowait(); return value >= 0; }
+    void await_suspend(std::coroutine_handle<> c) { handle = c; executor::current()->wait_uart(*this); }
+    int await_resume() const noexcept { return value; }
+};
+
+// IRQ line fired; the line stays disabled until awaited again
+struct irq : resume_waiter {
+    explicit irq(int l) { line = l; }
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> c) { handle = c; executor::current()->wait_irq(*this, line); }
+    void await_resume() const noexcept {}
+};
+
+// mtimer deadline, ticks of rtc_now(); false if the hart has no mtimer comparator
+struct sleep_until : resume_waiter {
+    explicit sleep_until(sys_tick_t t) { deadline = t; }
+    bool await_ready() const { return rtc_now() >= deadline; }
+    bool await_suspend(std::coroutine_handle<> c) { handle = c; return executor::current()->wait_until(*this, deadline); }
+    bool await_resume() const { return rtc_now() >= deadline; }
+};
+
+struct sleep_for : sleep_until {
+    explicit sleep_for(sys_tick_t ticks) : sleep_until(rtc_now() + ticks) {}
+};
+
+// message from another hart (or an interrupt handler) through the ring queue
+struct message : resume_waiter {
+    explicit message(arch_spsc_ring_t &r) : spsc_(&r) {}
+    explicit message(arch_mpmc_ring_t &r) : mpmc_(&r) {}
+
+    bool await_ready() { return spsc_ ? arch_spsc_pop(spsc_, &item) : arch_mpmc_pop(mpmc_, &item); }
+
+    void await_suspend(std::coroutine_handle<> c)
+    {
+        handle = c;
+        if (spsc_)
+            executor::current()->wait_spsc(*this, *spsc_);
+        else
+            executor::current()->wait_mpmc(*this, *mpmc_);
+    }
+
+    void *await_resume() const noexcept { return item; }
+
+private:
+    arch_spsc_ring_t *spsc_ = nullptr;
+    arch_mpmc_ring_t *mpmc_ = nullptr;
+};
+
+// let the other ready coroutines run
+struct yield : resume_waiter {
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> c) { handle = c; executor::current()->post(*this); }
+    void await_resume() const noexcept {}
+};
+
+#endif // HAL_CORO_SUPPORTED
+
+} // namespace co
+} // namespace hal
+
+#endif // SCR_BSP_CORO_H
@@ -51,6 +51,28 @@
 #include "asm-magic.h"
 #endif // INSN_NOT_SUPPORTED
 
+// Standard cache-block operations (Zicbom) are used instead of the custom
+// clflush/clinval ones when the target ISA (-march) declares them.
+// The block size of the hardware may be bigger than the L1 line size,
+// smaller step is safe for cbo.clean/flush/inval.
+#if defined(__riscv_zicbom)
+#ifndef PLF_CBOM_BLOCK_SIZE
+#define PLF_CBOM_BLOCK_SIZE PLF_CACHELINE_SIZE
+#endif
+#define CACHE_OP_BLOCK_SIZE PLF_CBOM_BLOCK_SIZE
+#else
+#define CACHE_OP_BLOCK_SIZE PLF_CACHELINE_SIZE
+#endif // __riscv_zicbom
+
+// cbo.zero clears the whole block, so Zicboz is used only if the platform
+// defines the exact block size
+#if defined(__riscv_zicboz) && defined(PLF_CBOZ_BLOCK_SIZE)
+#define PLF_CACHE_CBOZ_SUPPORT 1
+#ifndef CACHE_ZERO_MIN_SIZE
+#define CACHE_ZERO_MIN_SIZE (4 * PLF_CBOZ_BLOCK_SIZE)
+#endif
+#endif // __riscv_zicboz && PLF_CBOZ_BLOCK_SIZE
+
 // cache control CSRs
 #define SCR_CSR_CACHE_GLBL (0xBD4)
 // cache info CSRs
@@ -193,6 +215,10 @@ bool plf_l1cache_is_enabled(void);
 void plf_l1cache_init(void);
 void cache_l1_invalidate(void *vaddr, long size);
 void cache_l1_flush(void *vaddr, long size);
+void cache_l1_clean(void *vaddr, long size);
+
+// memset() with cbo.zero fast path for big blocks of zeroes (if Zicboz is supported)
+void *cache_memset(void *dst, int c, size_t size);
 
 int cache_l1i_info(char *buf, size_t len);
 int cache_l1d_info(char *buf, size_t len);
@@ -207,6 +233,41 @@ static inline void plf_l1cache_flush(void *vaddr, long size)
    cache_l1_flush(vaddr, size);
 }
 
+static inline void plf_l1cache_clean(void *vaddr, long size)
+{
+   cache_l1_clean(vaddr, size);
+}
+
+// Software prefetch hints (Zicbop). The encodings belong to the ORI hint space,
+// so they are executed as no-ops by harts without Zicbop
+#if defined(__riscv_zicbop)
+#define CACHE_PREFETCH(type, addr) \
+    asm volatile("prefetch." #type " 0(%0)" :: "r"(addr))
+#elif !defined(INSN_NOT_SUPPORTED)
+#define CACHE_PREFETCH_TYPE_i 0
+#define CACHE_PREFETCH_TYPE_r 1
+#define CACHE_PREFETCH_TYPE_w 3
+#define CACHE_PREFETCH(type, addr) \
+    asm volatile(".insn i OP_IMM, 6, zero, %0, " STRINGIFY(CACHE_PREFETCH_TYPE_##type) :: "r"(addr))
+#else
+#define CACHE_PREFETCH(type, addr) ((void)(addr))
+#endif // __riscv_zicbop
+
+static inline __attribute__((always_inline)) void cache_prefetch_r(const void *addr)
+{
+    CACHE_PREFETCH(r, addr);
+}
+
+static inline __attribute__((always_inline)) void cache_prefetch_w(const void *addr)
+{
+    CACHE_PREFETCH(w, addr);
+}
+
+static inline __attribute__((always_inline)) void cache_prefetch_i(const void *addr)
+{
+    CACHE_PREFETCH(i, addr);
+}
+
 static inline __attribute__((always_inline))
 void plf_l1cache_debug_feature_reset(uint64_t feature_bit)
 {
@@ -381,10 +442,16 @@ void plf_l2cache_enable(void);
 void plf_l2cache_disable(void);
 bool plf_l2cache_is_enabled(void);
 void plf_l2cache_init(void);
+// split plf_l2cache_init() to overlap the invalidation with other work
+void plf_l2cache_init_start(void);
+void plf_l2cache_init_finish(void);
 
 int cache_l2_info(char *buf, size_t len);
 
 void plf_l3cache_init(void);
+// split plf_l3cache_init() to overlap the invalidation with other work
+void plf_l3cache_init_start(void);
+void plf_l3cache_init_wait(void);
 
 int cache_l3_info(char *buf, size_t len);
 
@@ -400,7 +467,17 @@ int cache_l3_info(char *buf, size_t len);
 
 // assembler macros
 
-#ifndef INSN_NOT_SUPPORTED
+#if defined(__riscv_zicbom)
+// cache block flush
+.macro clflush reg
+    cbo.flush (\reg)
+.endm
+
+// cache block invalidate
+.macro clinval reg
+    cbo.inval (\reg)
+.endm
+#elif !defined(INSN_NOT_SUPPORTED)
 // cache line flush
 .macro clflush reg
     .insn i SYSTEM, 0, zero, \reg, 0b000100001001
@@ -410,7 +487,7 @@ int cache_l3_info(char *buf, size_t len);
 .macro clinval reg
     .insn i SYSTEM, 0, zero, \reg, 0b000100001000
 .endm
-#endif // INSN_NOT_SUPPORTED
+#endif // __riscv_zicbom
 
 // reset L1 and disable caching
 .macro cache_l1_reset_nc
@@ -439,8 +516,8 @@ cache_inv_skip:
     LOCAL cache_flush_loop
 cache_flush_loop:
     clflush \addr
-    addi \size, \size, -PLF_CACHELINE_SIZE
-    addi \addr, \addr, PLF_CACHELINE_SIZE
+    addi \size, \size, -CACHE_OP_BLOCK_SIZE
+    addi \addr, \addr, CACHE_OP_BLOCK_SIZE
     bgez \size, cache_flush_loop
 .endm // cache_l1_flush
 
@@ -41,9 +41,13 @@
 extern "C" {
 #endif
 
+#define CLINT_MSIP_BASE (PLF_CLINT_BASE)
 #define CLINT_MTIMER_BASE (PLF_CLINT_BASE + 0xbff8)
 #define CLINT_MTIMER_CMP_BASE (PLF_CLINT_BASE + 0x4000)
 
+// machine software interrupt pending register of the hart
+#define CLINT_MSIP(hart) (*(volatile uint32_t*)(CLINT_MSIP_BASE + (hart) * 4))
+
 #if __riscv_xlen == 32
 #define CLINT_MTIMER (*(volatile uint32_t*)(CLINT_MTIMER_BASE))
 #define CLINT_MTIMERH (*(volatile uint32_t*)(CLINT_MTIMER_BASE + 4))
@@ -92,6 +96,20 @@ static inline void clint_mtimer_setcmp_offset(sys_tick_t to)
     clint_mtimer_setcmp(clint_mtimer_current() + to);
 }
 
+// comparator of the hart (number relative to PLF_SMP_HARTID_BASE)
+static inline void clint_mtimer_setcmp_hart(unsigned hart, sys_tick_t t)
+{
+#if __riscv_xlen == 32
+    volatile uint32_t *cmp = (volatile uint32_t*)(CLINT_MTIMER_CMP_BASE + hart * 8);
+
+    cmp[1] = ~0;
+    cmp[0] = (uint32_t)t;
+    cmp[1] = (uint32_t)(t >> 32);
+#else //  __riscv_xlen == 32
+    *(volatile uint64_t*)(CLINT_MTIMER_CMP_BASE + hart * 8) = t;
+#endif // __riscv_xlen == 32
+}
+
 static inline void clint_mtimer_set(sys_tick_t t)
 {
 #if __riscv_xlen == 32
@@ -124,6 +142,18 @@ static inline void clint_mtimer_init(void)
     clint_mtimer_enable();
 }
 
+// software interrupts
+
+static inline void clint_msip_set(unsigned hart)
+{
+    CLINT_MSIP(hart) = 1;
+}
+
+static inline void clint_msip_clear(unsigned hart)
+{
+    CLINT_MSIP(hart) = 0;
+}
+
 #pragma GCC diagnostic pop
 
 #ifdef __cplusplus
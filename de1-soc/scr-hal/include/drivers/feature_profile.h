@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2015, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Microarchitecture feature profiles (BPU, L1D debug options, prefetchers)
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2015, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#ifndef SCR_BSP_FEATURE_PROFILE_H
+#define SCR_BSP_FEATURE_PROFILE_H
+
+#include "drivers/cache.h"
+#include "drivers/feature_enable.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A profile owns only the bits set in its masks, other bits of the CSRs are kept untouched.
+// The values are raw CSR values: note that L1D_DEBUG_OPTIONS bits are "disable" bits.
+typedef struct {
+    const char* name;
+    unsigned long feature_mask;        // SCR_CSR_FEATURE_ENABLE
+    unsigned long feature_value;
+    unsigned long l1d_debug_mask;      // L1D_DEBUG_OPTIONS
+    unsigned long l1d_debug_value;
+    unsigned long l1d_prefetcher_mask; // L1D_PREFETCHER_CTRL_REG_0
+    unsigned long l1d_prefetcher_value;
+} plf_feature_profile_t;
+
+// per hart profile switch statistics
+typedef struct {
+    unsigned long switches;
+    unsigned long csr_writes;
+    unsigned long last_cycles;
+    unsigned long max_cycles;
+    uint64_t total_cycles;
+} plf_feature_profile_stat_t;
+
+#define PLF_FEATURE_PROFILE_INIT(profile_name) { .name = (profile_name) }
+
+#define L1D_PREFETCHER_PARAMS_MASK                                              \
+    ((L1D_PREFETCHER_PARAM_MASK << L1D_PREFETCHER_CONF_CTR_TH_SHIFT) |          \
+     (L1D_PREFETCHER_PARAM_MASK << L1D_PREFETCHER_CONF_CTR_MAX_SHIFT) |         \
+     (L1D_PREFETCHER_PARAM_MASK << L1D_PREFETCHER_PREF_CTR_MAX_SHIFT))
+
+static inline void plf_feature_profile_set(plf_feature_profile_t* profile,
+                                           unsigned long feature_bit, bool enable)
+{
+    profile->feature_mask |= feature_bit;
+    if (enable)
+        profile->feature_value |= feature_bit;
+    else
+        profile->feature_value &= ~feature_bit;
+}
+
+static inline void plf_feature_profile_set_l1d_debug(plf_feature_profile_t* profile,
+                                                     unsigned long disable_bit, bool enable)
+{
+    profile->l1d_debug_mask |= disable_bit;
+    if (enable)
+        profile->l1d_debug_value &= ~disable_bit;
+    else
+        profile->l1d_debug_value |= disable_bit;
+}
+
+static inline void plf_feature_profile_set_l1d_prefetcher(plf_feature_profile_t* profile,
+                                                          bool enable)
+{
+    profile->l1d_prefetcher_mask |= L1D_PREFETCHER_ENABLE_BIT;
+    if (enable)
+        profile->l1d_prefetcher_value |= L1D_PREFETCHER_ENABLE_BIT;
+    else
+        profile->l1d_prefetcher_value &= ~(unsigned long)L1D_PREFETCHER_ENABLE_BIT;
+}
+
+// shift is one of L1D_PREFETCHER_*_SHIFT
+static inline void plf_feature_profile_set_l1d_prefetcher_param(plf_feature_profile_t* profile,
+                                                                unsigned shift, unsigned long value)
+{
+    const unsigned long mask = (unsigned long)L1D_PREFETCHER_PARAM_MASK << shift;
+
+    profile->l1d_prefetcher_mask |= mask;
+    profile->l1d_prefetcher_value = (profile->l1d_prefetcher_value & ~mask) | ((value << shift) & mask);
+}
+
+// Fill the profile with the current state of all knobs available on the hart
+void plf_feature_profile_capture(plf_feature_profile_t* profile, const char* name);
+
+// Apply the profile writing only the CSRs which bits differ from the current state.
+// If `saved` is not NULL, it receives the previous state of the bits owned by the profile,
+// so plf_feature_profile_restore(saved) brings the hart back.
+// Knobs not available on the hart are ignored.
+// Returns the number of CSR writes performed.
+int plf_feature_profile_apply(const plf_feature_profile_t* profile, plf_feature_profile_t* saved);
+
+static inline int plf_feature_profile_restore(const plf_feature_profile_t* saved)
+{
+    return plf_feature_profile_apply(saved, NULL);
+}
+
+// Returns true if the current hart state matches the profile
+bool plf_feature_profile_is_active(const plf_feature_profile_t* profile);
+
+const plf_feature_profile_stat_t* plf_feature_profile_stat(void);
+void plf_feature_profile_stat_reset(void);
+
+int plf_feature_profile_info(const plf_feature_profile_t* profile, char* buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCR_BSP_FEATURE_PROFILE_H
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2015, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Inter-processor interrupts and cross-hart cache maintenance
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2015, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#ifndef SCR_BSP_IPI_H
+#define SCR_BSP_IPI_H
+
+#include "arch.h"
+
+// IPI delivery: CLINT msip, IMSIC MSI or ICCM message
+#if PLF_SMP_SUPPORT
+#if defined(PLF_CLINT_BASE)
+#define PLF_IPI_CLINT 1
+#elif defined(PLF_IMSIC_BASE_M)
+#define PLF_IPI_IMSIC 1
+// IMSIC interrupt identity used for IPIs
+#ifndef PLF_IMSIC_IPI_ID
+#define PLF_IMSIC_IPI_ID (1)
+#endif
+#elif PLF_ICCM_L3_SUPPORT
+// ICCM raises the machine software interrupt while the receiver buffer is not empty
+#define PLF_IPI_ICCM 1
+#endif
+#endif // PLF_SMP_SUPPORT
+
+#if PLF_IPI_CLINT || PLF_IPI_IMSIC || PLF_IPI_ICCM
+#define PLF_IPI_SUPPORT 1
+#else
+#define PLF_IPI_SUPPORT 0
+#endif
+
+#ifndef __ASSEMBLER__
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// cross-hart cache operations
+enum {
+    IPI_CACHE_L1_FLUSH = 1,      // cache_l1_flush(addr, size)
+    IPI_CACHE_L1_INVALIDATE,     // cache_l1_invalidate(addr, size)
+    IPI_CACHE_L1_CLEAN,          // cache_l1_clean(addr, size)
+    IPI_CACHE_FENCE_I            // fence.i (code patching)
+};
+
+#define IPI_HARTS_ALL (~0UL)
+
+// hart number (mhartid - PLF_SMP_HARTID_BASE) to send IPI to
+void ipi_send(unsigned hart);
+void ipi_clear(void);
+
+// Enable IPI receiving on the calling hart, enables M-mode interrupts.
+// Each hart that is expected to serve ipi_cache_op() requests has to call it,
+// the requests to other harts are skipped (and counted by ipi_cache_op()).
+void ipi_init(void);
+
+// Serve pending IPI request from the trap handler.
+// Returns true if the trap was caused by an IPI.
+// The HAL default trap handler calls it, a custom trap handler should do the same.
+bool ipi_trap_handler(unsigned long mcause);
+
+// Execute cache operation on the harts from the mask (bit per hart number)
+// and wait for completion acknowledgements. The calling hart executes the operation in place.
+// Must not be called with interrupts disabled or from a trap handler.
+// Returns the number of requested harts skipped because they have not called ipi_init()
+// (0: the operation is done by all of them), or -1 if other harts are requested but IPIs
+// are not supported by the platform.
+int ipi_cache_op(unsigned long hart_mask, unsigned op, void *addr, long size);
+
+static inline int ipi_cache_flush_all(void *addr, long size)
+{
+    return ipi_cache_op(IPI_HARTS_ALL, IPI_CACHE_L1_FLUSH, addr, size);
+}
+
+static inline int ipi_cache_invalidate_all(void *addr, long size)
+{
+    return ipi_cache_op(IPI_HARTS_ALL, IPI_CACHE_L1_INVALIDATE, addr, size);
+}
+
+static inline int ipi_fence_i_all(void)
+{
+    return ipi_cache_op(IPI_HARTS_ALL, IPI_CACHE_FENCE_I, 0, 0);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !__ASSEMBLER__
+#endif // SCR_BSP_IPI_H
@@ -125,6 +125,16 @@ static inline void scr_mtimer_setcmp_offset(sys_tick_t to)
     scr_mtimer_setcmp(scr_mtimer_current() + to);
 }
 
+#ifdef PLF_MTIMER_EXT
+// comparator of the core (hart number relative to PLF_SMP_HARTID_BASE)
+static inline void scr_mtimer_setcmp_core(unsigned core, sys_tick_t t)
+{
+    *(volatile uint32_t*)SCR_RTC_MTIMECMPH_CORE(core) = ~0;
+    *(volatile uint32_t*)SCR_RTC_MTIMECMP_CORE(core)  = (uint32_t)t;
+    *(volatile uint32_t*)SCR_RTC_MTIMECMPH_CORE(core) = (uint32_t)(t >> 32);
+}
+#endif // PLF_MTIMER_EXT
+
 static inline void scr_mtimer_set(sys_tick_t t)
 {
 #if __riscv_xlen == 32
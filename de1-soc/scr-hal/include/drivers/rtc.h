@@ -32,6 +32,7 @@
 
 #include "arch.h"
 #include "csr.h"
+#include "spin.h"
 
 #ifndef PLF_RTC_TIMEBASE
 #define PLF_RTC_TIMEBASE 1000000
@@ -86,11 +87,18 @@ extern "C" {
 #define rtc_now()   scr_mtimer_current()
 #define rtc_setcmp(t) scr_mtimer_setcmp(t)
 #define rtc_setcmp_offset(t) scr_mtimer_setcmp_offset(t)
+#ifdef PLF_MTIMER_EXT
+#define rtc_setcmp_hart(h, t) scr_mtimer_setcmp_core(h, t)
+#else
+// single comparator
+#define rtc_setcmp_hart(h, t) ((void)(h), scr_mtimer_setcmp(t))
+#endif // PLF_MTIMER_EXT
 #elif defined(PLF_CLINT_BASE)
 #define rtc_init()  clint_mtimer_init()
 #define rtc_now()   clint_mtimer_current()
 #define rtc_setcmp(t) clint_mtimer_setcmp(t)
 #define rtc_setcmp_offset(t) clint_mtimer_setcmp_offset(t)
+#define rtc_setcmp_hart(h, t) clint_mtimer_setcmp_hart(h, t)
 #endif
 
 static inline unsigned long rtc_ticks2ns(sys_tick_t t)
@@ -138,9 +146,7 @@ static inline void rtc_delay_ticks(unsigned long ticks)
     sys_tick_t t = rtc_now();
 
     if (ticks > 100) {
-        do {
-            cpu_relax();
-        } while ((rtc_now() - t) < ticks);
+        arch_spin_until(&arch_spin_site_rtc, (rtc_now() - t) >= ticks);
     } else {
         while ((rtc_now() - t) < ticks);
     }
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Cooperative fibers
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#ifndef SCR_BSP_FIBER_H
+#define SCR_BSP_FIBER_H
+
+/*
+ * Saved context layout, shared with fiber_switch.S.
+ * ra and s0..s11 are pushed to the fiber stack (HAL_FIBER_FRAME_SIZE bytes),
+ * the context keeps the stack pointer and the FP callee-saved state.
+ * The FP state is saved only if mstatus.FS is Dirty at the switch and restored
+ * only if it was saved; the vector registers are caller-saved by the ABI and
+ * are never live across hal_fiber_yield().
+ */
+#define HAL_FIBER_XLEN        (__riscv_xlen / 8)
+#define HAL_FIBER_CTX_SP      (0)
+#define HAL_FIBER_CTX_FP      (1 * HAL_FIBER_XLEN) // non-zero: fs0..fs11 and fcsr are saved
+#define HAL_FIBER_CTX_FCSR    (2 * HAL_FIBER_XLEN)
+#define HAL_FIBER_CTX_FREGS   (4 * HAL_FIBER_XLEN)
+#define HAL_FIBER_FRAME_SIZE  (16 * HAL_FIBER_XLEN)
+
+#ifndef __ASSEMBLER__
+
+#include "arch.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fibers are cooperative threads of a hart: a fiber runs until it calls
+ * hal_fiber_yield() or hal_fiber_join() or returns from its function.
+ * Every hart has its own FIFO run queue, a fiber stays on the hart that created it.
+ * The original context of the hart (e.g. main()) takes part in the scheduling
+ * as the hart's root fiber.
+ * The stacks are taken from the heap and filled with a pattern, the lowest
+ * PLF_FIBER_GUARD_SIZE bytes are the guard: if PLF_FIBER_STACK_CHECK is set,
+ * it is checked on every switch from the fiber, otherwise on join only.
+ * A damaged guard calls hal_fiber_stack_overflow().
+ * Every created fiber must be joined by a fiber of the same hart, the join frees it.
+ * The fiber API must not be used from the interrupt handlers.
+ */
+#ifndef PLF_FIBER_STACK_SIZE
+#define PLF_FIBER_STACK_SIZE (4096)
+#endif
+
+#ifndef PLF_FIBER_GUARD_SIZE
+#define PLF_FIBER_GUARD_SIZE (64)
+#endif
+
+#ifndef PLF_FIBER_STACK_CHECK
+#define PLF_FIBER_STACK_CHECK 1
+#endif
+
+typedef struct hal_fiber_ctx {
+    void *sp;
+    unsigned long fp_saved;
+    unsigned long fcsr;
+    unsigned long reserved;
+#if __riscv_flen == 64
+    uint64_t fregs[12];
+#elif __riscv_flen == 32
+    uint32_t fregs[12];
+#endif
+} hal_fiber_ctx_t;
+
+typedef struct hal_fiber hal_fiber_t;
+typedef void (*hal_fiber_fn_t)(void *arg);
+
+typedef struct hal_fiber_stat {
+    unsigned long created;
+    unsigned long live;     // created and not joined
+    unsigned long switches;
+} hal_fiber_stat_t;
+
+// stack_size == 0: PLF_FIBER_STACK_SIZE
+// the fiber is queued on the calling hart; returns NULL if out of memory or the stack is too small
+hal_fiber_t *hal_fiber_create(hal_fiber_fn_t fn, void *arg, size_t stack_size);
+// switch to the next fiber of the hart, returns immediately if there is none
+void hal_fiber_yield(void);
+// yield until the fiber is finished and free it
+// returns 0 or -EFAULT if the stack guard is damaged
+int hal_fiber_join(hal_fiber_t *fiber);
+// NULL: the hart's root context
+hal_fiber_t *hal_fiber_self(void);
+// returns 0 or -EFAULT if the stack guard is damaged
+int hal_fiber_check_stack(const hal_fiber_t *fiber);
+// stack high-water mark in bytes
+size_t hal_fiber_stack_used(const hal_fiber_t *fiber);
+// statistics of the calling hart
+void hal_fiber_get_stat(hal_fiber_stat_t *stat);
+
+// low level switch: saves the current context to from, resumes to
+void hal_fiber_switch(hal_fiber_ctx_t *from, hal_fiber_ctx_t *to);
+
+// weak, the default one aborts
+void hal_fiber_stack_overflow(const hal_fiber_t *fiber);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !__ASSEMBLER__
+
+#endif // SCR_BSP_FIBER_H
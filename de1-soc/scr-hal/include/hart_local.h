@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief hart-local data
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+#ifndef SCR_BSP_HART_LOCAL_H
+#define SCR_BSP_HART_LOCAL_H
+
+#include "arch.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hart-local storage: variables declared __hart_local are placed into
+ * the .hart_local section (see bsp0.lds), which is replicated for every hart.
+ * The section is aligned and padded to PLF_MAX_CACHELINE_SIZE, so the data of
+ * different harts never share a cache line. Copy 0 is at the link address,
+ * the copy of hart N is N section sizes above it.
+ * The data is zero-initialized with BSS (also with HAL_SKIP_BSS_INIT),
+ * initializers are not supported.
+ * this_hart_local(var) - pointer to the calling hart's copy,
+ * hart_local_ptr(var, hart) - pointer to the copy of the hart
+ * (number relative to PLF_SMP_HARTID_BASE), e.g. to read the data of another hart.
+ * Not hart-local on purpose: hart_start_table (sys_init.c) hands the TLS pointer
+ * to the secondary harts in crt0 before BSS and this section are initialized and
+ * is written by the master hart for the others; the rtc clock calibration
+ * (rtc_dyn_hart_clock_rate()) keeps no state between calls.
+ */
+#define __hart_local __attribute__((section(".bss.hart_local")))
+
+extern char __hart_local_start[];
+extern char __hart_local_end[];
+
+static inline unsigned hart_local_index(void)
+{
+#ifdef PLF_SMP_SUPPORT
+    return (unsigned)(arch_hartid() - PLF_SMP_HARTID_BASE);
+#else
+    return 0;
+#endif // PLF_SMP_SUPPORT
+}
+
+static inline uintptr_t hart_local_stride(void)
+{
+    return (uintptr_t)(__hart_local_end - __hart_local_start);
+}
+
+#define hart_local_ptr(var, hart) \
+    ((__typeof__(&(var)))((uintptr_t)&(var) + (uintptr_t)(hart) * hart_local_stride()))
+
+#define this_hart_local(var) hart_local_ptr(var, hart_local_index())
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCR_BSP_HART_LOCAL_H
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Per-hart heap arenas
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+
+#ifndef SCR_BSP_HEAP_H
+#define SCR_BSP_HEAP_H
+
+#include "arch.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Per-hart heap arenas.
+ * Every hart allocates from its own arena (hart-local free lists and a chunk
+ * of PLF_MALLOC_ARENA_CHUNK bytes taken from sbrk()), so allocations of
+ * different harts do not serialize. Blocks are rounded up to size classes:
+ * multiples of 16 bytes up to 1 KiB, powers of 2 above. A block freed by another
+ * hart is queued to the owner arena and reused by the owner on its next
+ * allocation of the size class. Freed memory is kept in the arenas, not returned to sbrk().
+ * With HAL_MALLOC=arenas malloc() and friends are implemented by the arenas.
+ * The allocated memory is not written back on PLF_SMP_NON_COHERENT platforms.
+ */
+#ifndef PLF_MALLOC_ARENA_CHUNK
+#define PLF_MALLOC_ARENA_CHUNK (64 * 1024)
+#endif
+
+void *hal_arena_malloc(size_t size);
+void hal_arena_free(void *ptr);
+void *hal_arena_realloc(void *ptr, size_t size);
+void *hal_arena_calloc(size_t n, size_t size);
+// align is a power of 2
+void *hal_arena_memalign(size_t align, size_t size);
+size_t hal_arena_usable_size(const void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCR_BSP_HEAP_H
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief ICCM message based lock and semaphore
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+#ifndef SCR_BSP_ICCM_LOCK_H
+#define SCR_BSP_ICCM_LOCK_H
+
+#include "arch.h"
+#include "lock.h"
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Lock and counting semaphore served by an arbiter hart over the L3 ICCM
+ * message channels: a hart sends a request to the arbiter and waits for
+ * the grant message in its own receive buffer, so no shared memory is
+ * written, flushed or invalidated. The arbiter state is private to the
+ * arbiter hart and updated from its ICCM interrupt (ipi_init() on the
+ * arbiter) or when the arbiter itself waits for a grant or calls
+ * arch_iccm_service().
+ * Objects are identified by address: 28 bits of (addr >> 2) are sent, so all
+ * ICCM locks and semaphores must lie within a 1 GiB window and not at a 1 GiB
+ * boundary (key 0 marks a free arbiter slot, such objects abort).
+ * The lock does not touch memory: on PLF_SMP_NON_COHERENT platforms the
+ * protected data has to be written back/invalidated by the user.
+ * Without ICCM the API falls back to arch_lock_t, the semaphore to a counter
+ * protected by arch_lock_t.
+ */
+#if PLF_SMP_SUPPORT && PLF_ICCM_L3_SUPPORT
+#define PLF_ICCM_LOCK_SUPPORT 1
+#else
+#define PLF_ICCM_LOCK_SUPPORT 0
+#endif
+
+// arbiter hart number (relative to PLF_SMP_HARTID_BASE)
+#ifndef PLF_ICCM_LOCK_ARBITER
+#if PLF_SMP_SUPPORT
+#define PLF_ICCM_LOCK_ARBITER (PLF_SMP_MASTER_HARTID - PLF_SMP_HARTID_BASE)
+#else
+#define PLF_ICCM_LOCK_ARBITER (0)
+#endif
+#endif
+
+// max number of locks/semaphores in use (held or waited for) at the same time
+#ifndef PLF_ICCM_LOCK_SLOTS
+#define PLF_ICCM_LOCK_SLOTS (32)
+#endif
+
+#if PLF_ICCM_LOCK_SUPPORT
+
+typedef struct arch_iccm_lock {
+    int unused;
+} arch_iccm_lock_t;
+
+typedef struct arch_iccm_sem {
+    int unused;
+} arch_iccm_sem_t;
+
+#define ARCH_ICCM_LOCK_INIT(i) { 0 }
+
+void arch_iccm_lock(arch_iccm_lock_t *lock);
+int arch_iccm_trylock(arch_iccm_lock_t *lock);
+void arch_iccm_unlock(arch_iccm_lock_t *lock);
+
+// the count is kept by the arbiter, init sends count V operations
+void arch_iccm_sem_init(arch_iccm_sem_t *sem, unsigned count);
+void arch_iccm_sem_wait(arch_iccm_sem_t *sem);
+int arch_iccm_sem_trywait(arch_iccm_sem_t *sem);
+void arch_iccm_sem_post(arch_iccm_sem_t *sem);
+
+// serve the pending requests, for an arbiter hart running with interrupts disabled
+void arch_iccm_service(void);
+
+// HAL internal: consume the received ICCM messages, returns the number of messages
+unsigned iccm_lock_pump(void);
+
+#else // PLF_ICCM_LOCK_SUPPORT
+
+typedef arch_lock_t arch_iccm_lock_t;
+
+#define ARCH_ICCM_LOCK_INIT(i) ARCH_LOCK_INIT(i)
+
+static inline void arch_iccm_lock(arch_iccm_lock_t *lock) { arch_lock(lock); }
+static inline int arch_iccm_trylock(arch_iccm_lock_t *lock) { return arch_trylock(lock); }
+static inline void arch_iccm_unlock(arch_iccm_lock_t *lock) { arch_unlock(lock); }
+
+typedef struct arch_iccm_sem {
+    arch_lock_t lock;
+    volatile int count;
+} arch_iccm_sem_t;
+
+static inline void arch_iccm_sem_sync(arch_iccm_sem_t *sem, bool out)
+{
+#if PLF_SMP_NON_COHERENT
+    if (out)
+        cache_l1_flush((void*)&sem->count, sizeof(sem->count));
+    else
+        cache_l1_invalidate((void*)&sem->count, sizeof(sem->count));
+#else // PLF_SMP_NON_COHERENT
+    (void)sem;
+    (void)out;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static inline void arch_iccm_sem_init(arch_iccm_sem_t *sem, unsigned count)
+{
+    const arch_lock_t lock = ARCH_LOCK_INIT(0);
+
+    sem->lock = lock;
+    sem->count = (int)count;
+    arch_iccm_sem_sync(sem, true);
+}
+
+static inline int arch_iccm_sem_trywait(arch_iccm_sem_t *sem)
+{
+    int res = 0;
+
+    arch_lock(&sem->lock);
+    arch_iccm_sem_sync(sem, false);
+    if (sem->count > 0) {
+        --sem->count;
+        arch_iccm_sem_sync(sem, true);
+        res = 1;
+    }
+    arch_unlock(&sem->lock);
+
+    return res;
+}
+
+static inline void arch_iccm_sem_wait(arch_iccm_sem_t *sem)
+{
+    while (!arch_iccm_sem_trywait(sem)) {
+#ifdef PLF_SMP_SUPPORT
+        // woken up by arch_unlock() of the posting hart
+        arch_spin_until(&arch_spin_site_lock, (arch_iccm_sem_sync(sem, false), sem->count > 0));
+#endif // PLF_SMP_SUPPORT
+    }
+}
+
+static inline void arch_iccm_sem_post(arch_iccm_sem_t *sem)
+{
+    arch_lock(&sem->lock);
+    arch_iccm_sem_sync(sem, false);
+    ++sem->count;
+    arch_iccm_sem_sync(sem, true);
+    arch_unlock(&sem->lock);
+}
+
+static inline void arch_iccm_service(void) {}
+
+#endif // PLF_ICCM_LOCK_SUPPORT
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCR_BSP_ICCM_LOCK_H
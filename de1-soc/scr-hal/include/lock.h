@@ -36,6 +36,7 @@
 
 #include "drivers/cache.h"
 #include "atomic.h"
+#include "spin.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -78,9 +79,7 @@ static inline int arch_is_locked(arch_lock_t *lock)
 
 static inline void arch_unlock_wait(arch_lock_t *lock)
 {
-    do {
-        cpu_relax();
-    } while (arch_is_locked(lock));
+    arch_spin_until(&arch_spin_site_lock, !arch_is_locked(lock));
 }
 
 #ifdef PLF_ARCH_TICKET_SPINLOCKS
@@ -104,6 +103,7 @@ static inline void arch_unlock(arch_lock_t *lock)
         : "=A" (lock->lock)
         :: "memory");
 #endif
+    arch_spin_wake(&arch_spin_site_lock);
 }
 
 static inline int arch_trylock(arch_lock_t *lock)
@@ -141,19 +141,13 @@ static inline void arch_lock(arch_lock_t *lock)
     */
     int ticket = atomic_add(1, &lock->tail);
 
-    while (ticket != atomic_read(&lock->owner))
-        cpu_relax();
+    arch_spin_until(&arch_spin_site_lock, ticket == atomic_read(&lock->owner));
 
     // acquire barrier
     __asm__ __volatile__ ("fence r , rw\n" ::: "memory");
 #else
-    while (1) {
-        if (arch_is_locked(lock))
-            continue;
-
-        if (arch_trylock(lock))
-            break;
-    }
+    while (!arch_trylock(lock))
+        arch_spin_until(&arch_spin_site_lock, !arch_is_locked(lock));
 #endif
 }
 
@@ -171,8 +165,73 @@ typedef struct arch_lock {
 
 void arch_unlock(arch_lock_t *lock);
 void arch_lock(arch_lock_t *lock);
+// fails if another hart holds the lock or is taking/releasing it, a hart
+// starting arch_lock() at the same moment may still be waited for
+int arch_trylock(arch_lock_t *lock);
+// another hart holds the lock or is taking/releasing it
+int arch_is_locked(arch_lock_t *lock);
+#endif // PLF_ATOMIC_SUPPORTED
+
+#if PLF_ATOMIC_SUPPORTED
+
+/*
+ * MCS queued spinlock: each waiter spins on its own cacheline-aligned node
+ * and the lock is handed over by a single store to the successor's node,
+ * so waiting harts do not hammer the lock cacheline.
+ * Nodes are taken from a per-hart pool in TLS, PLF_MCS_LOCK_NODES bounds
+ * the number of MCS locks held by a hart at the same time.
+ */
+#ifndef PLF_MCS_LOCK_NODES
+#define PLF_MCS_LOCK_NODES (4)
+#endif
+
+typedef struct arch_mcs_node {
+    struct arch_mcs_node *volatile next; // written by the successor
+#if PLF_SMP_NON_COHERENT
+    // written by another hart: keep in a separate cache line
+    char pad[PLF_MAX_CACHELINE_SIZE - sizeof(void*)];
+#endif // PLF_SMP_NON_COHERENT
+    volatile int locked;                 // written by the predecessor
+    int busy;
+} __attribute__((aligned(PLF_MAX_CACHELINE_SIZE))) arch_mcs_node_t;
+
+typedef struct arch_mcs_lock {
+    arch_mcs_node_t *volatile tail;
+    arch_mcs_node_t *owner;
+} arch_mcs_lock_t;
+
+#define ARCH_MCS_LOCK_INIT(i) { .tail = NULL, .owner = NULL }
+
+void arch_mcs_lock(arch_mcs_lock_t *lock);
+int arch_mcs_trylock(arch_mcs_lock_t *lock);
+void arch_mcs_unlock(arch_mcs_lock_t *lock);
+
+static inline int arch_mcs_is_locked(arch_mcs_lock_t *lock)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)&(lock->tail), sizeof(lock->tail));
+#endif // PLF_SMP_NON_COHERENT
+    return lock->tail != NULL;
+}
+
+#else // PLF_ATOMIC_SUPPORTED
+
+// no AMO: fall back to the generic lock
+typedef arch_lock_t arch_mcs_lock_t;
+
+#define ARCH_MCS_LOCK_INIT(i) ARCH_LOCK_INIT(i)
+
+static inline void arch_mcs_lock(arch_mcs_lock_t *lock) { arch_lock(lock); }
+static inline int arch_mcs_trylock(arch_mcs_lock_t *lock) { return arch_trylock(lock); }
+static inline void arch_mcs_unlock(arch_mcs_lock_t *lock) { arch_unlock(lock); }
+static inline int arch_mcs_is_locked(arch_mcs_lock_t *lock) { return arch_is_locked(lock); }
+
 #endif // PLF_ATOMIC_SUPPORTED
 
+#ifdef __cplusplus
+}
+#endif
+
 #else // PLF_SMP_SUPPORT
 
 typedef struct arch_lock {
@@ -200,9 +259,28 @@ static inline void arch_lock(arch_lock_t *lock)
     (void)lock;
 }
 
-#ifdef __cplusplus
+typedef arch_lock_t arch_mcs_lock_t;
+
+#define ARCH_MCS_LOCK_INIT(i) {}
+
+#define arch_mcs_is_locked(x) (0)
+
+static inline void arch_mcs_unlock(arch_mcs_lock_t *lock)
+{
+    (void)lock;
+}
+
+static inline int arch_mcs_trylock(arch_mcs_lock_t *lock)
+{
+    (void)lock;
+
+    return 1;
+}
+
+static inline void arch_mcs_lock(arch_mcs_lock_t *lock)
+{
+    (void)lock;
 }
-#endif
 
 #endif // PLF_SMP_SUPPORT
 
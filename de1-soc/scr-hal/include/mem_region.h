@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Memory regions: region heaps and static placement
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+#ifndef SCR_BSP_MEM_REGION_H
+#define SCR_BSP_MEM_REGION_H
+
+#include "tlsf.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Memory regions other than the program memory: on-chip RAM, TCM and DDR.
+ * The platform linker script (mem.ld) declares the regions available to the application
+ * by __<REGION>_ORIGIN__ / __<REGION>_LENGTH__ symbols.
+ * Static data is placed into a region by the __ocram, __tcm and __ddr attributes: the data
+ * is zero-initialized at startup, also with HAL_SKIP_BSS_INIT (initializers are not supported,
+ * the sections are NOLOAD).
+ * The rest of a declared region is a TLSF heap created on the first use.
+ * Data placed into an undeclared region (e.g. DDR when the program runs from DDR) goes to
+ * the program memory after the BSS, allocations from it use malloc().
+ */
+#define __ocram __attribute__((section(".ocram")))
+#define __tcm   __attribute__((section(".tcm")))
+#define __ddr   __attribute__((section(".ddr")))
+
+typedef enum {
+    HAL_MEM_DEFAULT, // malloc() heap
+    HAL_MEM_OCRAM,
+    HAL_MEM_TCM,
+    HAL_MEM_DDR,
+    HAL_MEM_REGIONS
+} hal_mem_region_t;
+
+void *hal_malloc_in(hal_mem_region_t region, size_t size);
+void *hal_memalign_in(hal_mem_region_t region, size_t align, size_t size);
+void *hal_calloc_in(hal_mem_region_t region, size_t n, size_t size);
+// ptr has to be allocated from the same region
+void hal_free_in(hal_mem_region_t region, void *ptr);
+
+// region heap statistics: returns 0 or -ENODEV if the region has no heap
+int hal_mem_region_get_stat(hal_mem_region_t region, hal_tlsf_stat_t *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCR_BSP_MEM_REGION_H
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Parallel loops over all harts
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+
+#ifndef SCR_BSP_PARALLEL_H
+#define SCR_BSP_PARALLEL_H
+
+#include "arch.h"
+#include "task.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Parallel loops on top of the task scheduler: the range [begin, end) is split
+ * into chunks executed by one team member per hart, the calling hart runs the
+ * first member and then helps in hal_task_sync(). The secondary harts take part
+ * while they serve tasks in hal_task_worker().
+ * Schedules:
+ * HAL_PARALLEL_STATIC  - one contiguous chunk per member
+ * HAL_PARALLEL_CHUNKED - chunks of grain iterations taken in order
+ * HAL_PARALLEL_GUIDED  - chunks of max(grain, remaining / (2 * harts)) iterations
+ * Guided and reduce chunks are never smaller than range / PLF_PARALLEL_MAX_CHUNKS.
+ * hal_parallel_reduce() reduces every chunk into its own partial value initialized
+ * with *result (the identity) and combines the partials on the calling hart in the
+ * chunk order, so for the same range, grain, schedule and hart number the result
+ * does not depend on the timing, even for non-associative float operations.
+ * The loops are not reentrant: do not nest them or call them from several harts at once.
+ */
+#ifndef PLF_PARALLEL_MAX_CHUNKS
+#define PLF_PARALLEL_MAX_CHUNKS (64)
+#endif
+
+// max size of a reduce value, bytes
+#ifndef PLF_PARALLEL_REDUCE_SIZE
+#define PLF_PARALLEL_REDUCE_SIZE (64)
+#endif
+
+typedef enum {
+    HAL_PARALLEL_STATIC,
+    HAL_PARALLEL_CHUNKED,
+    HAL_PARALLEL_GUIDED
+} hal_parallel_sched_t;
+
+// hal_parallel_for() schedule
+#ifndef PLF_PARALLEL_SCHEDULE
+#define PLF_PARALLEL_SCHEDULE HAL_PARALLEL_GUIDED
+#endif
+
+// runs iterations [begin, end)
+typedef void (*hal_for_fn_t)(long begin, long end, void *ctx);
+// accumulates iterations [begin, end) into *acc
+typedef void (*hal_reduce_fn_t)(long begin, long end, void *acc, void *ctx);
+// *acc = *acc op *val
+typedef void (*hal_combine_fn_t)(void *acc, const void *val, void *ctx);
+
+// accumulated per hart, hal_parallel_reset_stat() clears
+typedef struct hal_parallel_stat {
+    unsigned long loops;  // loops started by the hart
+    uint64_t loop_cycles; // cycles of the loops started by the hart
+    unsigned long chunks; // chunks executed by the hart
+    uint64_t body_cycles; // cycles in the loop body
+    uint64_t cycles;      // cycles in team members: body and dispatch
+} hal_parallel_stat_t;
+
+void hal_parallel_for_sched(hal_parallel_sched_t sched, long begin, long end, long grain,
+                            hal_for_fn_t fn, void *ctx);
+// returns -EINVAL if size > PLF_PARALLEL_REDUCE_SIZE
+int hal_parallel_reduce_sched(hal_parallel_sched_t sched, long begin, long end, long grain,
+                              hal_reduce_fn_t fn, hal_combine_fn_t combine,
+                              void *result, unsigned size, void *ctx);
+
+static inline void hal_parallel_for(long begin, long end, long grain, hal_for_fn_t fn, void *ctx)
+{
+    hal_parallel_for_sched(PLF_PARALLEL_SCHEDULE, begin, end, grain, fn, ctx);
+}
+
+static inline int hal_parallel_reduce(long begin, long end, long grain,
+                                      hal_reduce_fn_t fn, hal_combine_fn_t combine,
+                                      void *result, unsigned size, void *ctx)
+{
+    return hal_parallel_reduce_sched(PLF_PARALLEL_SCHEDULE, begin, end, grain,
+                                     fn, combine, result, size, ctx);
+}
+
+// hart number relative to PLF_SMP_HARTID_BASE
+void hal_parallel_get_stat(unsigned hart, hal_parallel_stat_t *stat);
+// must not be called while a loop is running
+void hal_parallel_reset_stat(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCR_BSP_PARALLEL_H
@@ -0,0 +1,452 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief inter-hart ring queues (SPSC and MPMC)
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#ifndef SCR_BSP_RING_H
+#define SCR_BSP_RING_H
+
+#include "arch.h"
+#include "atomic.h"
+#include "lock.h"
+#include "spin.h"
+#include "drivers/cache.h"
+#include "drivers/ipi.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bounded queues of pointers with a power of 2 number of slots,
+ * the storage is provided by the caller.
+ *
+ * arch_spsc_ring_t: single producer / single consumer, loads, stores and fences only.
+ * arch_mpmc_ring_t: multiple producers / consumers, per-slot sequence numbers
+ *                   updated by atomic_cas() (D. Vyukov bounded MPMC queue).
+ *
+ * push()/pop() never block and return false if the queue is full/empty.
+ * push_wait()/pop_wait() sleep in WFI if PLF_RING_WFI is enabled and
+ * are woken up by IPI from the other side (see drivers/ipi.h, the sleeping
+ * hart must call ipi_init()), otherwise they spin.
+ * Hart numbers of sleeping harts are limited to 0..30.
+ */
+#ifndef PLF_RING_WFI
+#define PLF_RING_WFI (PLF_IPI_SUPPORT && PLF_ATOMIC_SUPPORTED)
+#endif
+
+#ifdef PLF_MAX_CACHELINE_SIZE
+#define ARCH_RING_ALIGN __attribute__((aligned(PLF_MAX_CACHELINE_SIZE)))
+#else
+#define ARCH_RING_ALIGN __attribute__((aligned(64)))
+#endif
+
+static inline void arch_ring_sync_out(const volatile void *p, size_t size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_flush((void*)p, (long)size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static inline void arch_ring_sync_in(const volatile void *p, size_t size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)p, (long)size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+/*
+ * Sleep until `cond(arg)` becomes true. The hart announces itself in the
+ * `sleepers` mask (bit per hart) to the other side; interrupts are masked
+ * between the last check and WFI, so a wakeup IPI can not be consumed by
+ * the trap handler before sleeping.
+ */
+static inline void arch_ring_wait(arch_atomic_t *sleepers, bool (*cond)(void*), void *arg)
+{
+    while (!cond(arg)) {
+#if PLF_RING_WFI
+        const int self = 1 << (arch_hartid() - PLF_SMP_HARTID_BASE);
+        const unsigned long mstatus = clear_csr(mstatus, MSTATUS_MIE);
+
+        // seq_cst: the registration is ordered before the cond() re-check,
+        // pairs with fence() before the sleepers read in arch_ring_wake()
+        atomic_add_seq_cst(self, sleepers);
+
+        if (!cond(arg))
+            wfi();
+
+        atomic_add(-self, sleepers);
+
+        // take the pending IPI
+        set_csr(mstatus, mstatus & MSTATUS_MIE);
+#else
+        (void)sleepers;
+        arch_spin_until(&arch_spin_site_ring, cond(arg));
+#endif // PLF_RING_WFI
+    }
+}
+
+static inline void arch_ring_wake(arch_atomic_t *sleepers)
+{
+#if PLF_RING_WFI
+    fence();
+
+    const unsigned mask = (unsigned)atomic_read(sleepers);
+
+    for (unsigned h = 0; mask >> h; ++h) {
+        if (mask & (1U << h))
+            ipi_send(h);
+    }
+#else
+    (void)sleepers;
+#endif // PLF_RING_WFI
+}
+
+/// SPSC ring
+
+typedef struct arch_spsc_ring {
+    // producer side
+    struct {
+        unsigned long head;
+        unsigned long tail_cache;
+    } ARCH_RING_ALIGN prod;
+    // consumer side
+    struct {
+        unsigned long tail;
+        unsigned long head_cache;
+    } ARCH_RING_ALIGN cons;
+    // updated by AMO only
+    struct {
+        arch_atomic_t prod; // producer sleeping on full queue
+        arch_atomic_t cons; // consumer sleeping on empty queue
+    } ARCH_RING_ALIGN sleepers;
+    // read only
+    void *volatile *slots;
+    unsigned long mask;
+} arch_spsc_ring_t;
+
+// size must be a power of 2
+static inline void arch_spsc_init(arch_spsc_ring_t *r, void **slots, unsigned long size)
+{
+    r->prod.head = 0;
+    r->prod.tail_cache = 0;
+    atomic_set(&r->sleepers.prod, 0);
+    r->cons.tail = 0;
+    r->cons.head_cache = 0;
+    atomic_set(&r->sleepers.cons, 0);
+    r->slots = (void *volatile *)slots;
+    r->mask = size - 1;
+    arch_ring_sync_out(r, sizeof(*r));
+}
+
+static inline bool arch_spsc_full(arch_spsc_ring_t *r)
+{
+    if (r->prod.head - r->prod.tail_cache <= r->mask)
+        return false;
+
+    arch_ring_sync_in(&r->cons.tail, sizeof(r->cons.tail));
+    r->prod.tail_cache = *(volatile unsigned long*)&r->cons.tail;
+
+    return r->prod.head - r->prod.tail_cache > r->mask;
+}
+
+static inline bool arch_spsc_empty(arch_spsc_ring_t *r)
+{
+    if (r->cons.tail != r->cons.head_cache)
+        return false;
+
+    arch_ring_sync_in(&r->prod.head, sizeof(r->prod.head));
+    r->cons.head_cache = *(volatile unsigned long*)&r->prod.head;
+
+    return r->cons.tail == r->cons.head_cache;
+}
+
+static inline bool arch_spsc_push(arch_spsc_ring_t *r, void *item)
+{
+    if (arch_spsc_full(r))
+        return false;
+
+    const unsigned long head = r->prod.head;
+    void *volatile *slot = &r->slots[head & r->mask];
+
+    *slot = item;
+    arch_ring_sync_out(slot, sizeof(*slot));
+    // slot store is visible before the head
+    __asm__ __volatile__ ("fence w , w\n" ::: "memory");
+    *(volatile unsigned long*)&r->prod.head = head + 1;
+    arch_ring_sync_out(&r->prod.head, sizeof(r->prod.head));
+
+    arch_ring_wake(&r->sleepers.cons);
+
+    return true;
+}
+
+static inline bool arch_spsc_pop(arch_spsc_ring_t *r, void **item)
+{
+    if (arch_spsc_empty(r))
+        return false;
+
+    // head load is ordered before the slot load
+    __asm__ __volatile__ ("fence r , r\n" ::: "memory");
+
+    const unsigned long tail = r->cons.tail;
+    void *volatile *slot = &r->slots[tail & r->mask];
+
+    arch_ring_sync_in(slot, sizeof(*slot));
+    *item = *slot;
+    // slot load is done before the slot is given back to the producer
+    __asm__ __volatile__ ("fence r , w\n" ::: "memory");
+    *(volatile unsigned long*)&r->cons.tail = tail + 1;
+    arch_ring_sync_out(&r->cons.tail, sizeof(r->cons.tail));
+
+    arch_ring_wake(&r->sleepers.prod);
+
+    return true;
+}
+
+static inline bool arch_spsc_not_full(void *r) { return !arch_spsc_full((arch_spsc_ring_t*)r); }
+static inline bool arch_spsc_not_empty(void *r) { return !arch_spsc_empty((arch_spsc_ring_t*)r); }
+
+static inline void arch_spsc_push_wait(arch_spsc_ring_t *r, void *item)
+{
+    while (!arch_spsc_push(r, item))
+        arch_ring_wait(&r->sleepers.prod, arch_spsc_not_full, r);
+}
+
+static inline void *arch_spsc_pop_wait(arch_spsc_ring_t *r)
+{
+    void *item;
+
+    while (!arch_spsc_pop(r, &item))
+        arch_ring_wait(&r->sleepers.cons, arch_spsc_not_empty, r);
+
+    return item;
+}
+
+/// MPMC ring
+
+typedef struct arch_mpmc_cell {
+    arch_atomic_t seq;
+    void *volatile data;
+#if PLF_SMP_NON_COHERENT
+} ARCH_RING_ALIGN arch_mpmc_cell_t; // written back by whole lines: one cell per line
+#else
+} arch_mpmc_cell_t;
+#endif // PLF_SMP_NON_COHERENT
+
+typedef struct arch_mpmc_ring {
+    struct {
+        arch_atomic_t pos;
+    } ARCH_RING_ALIGN prod;
+    struct {
+        arch_atomic_t pos;
+    } ARCH_RING_ALIGN cons;
+    // updated by AMO only
+    struct {
+        arch_atomic_t prod; // producers sleeping on full queue
+        arch_atomic_t cons; // consumers sleeping on empty queue
+    } ARCH_RING_ALIGN sleepers;
+#if !PLF_ATOMIC_SUPPORTED
+    arch_lock_t lock;
+#endif // !PLF_ATOMIC_SUPPORTED
+    arch_mpmc_cell_t *cells;
+    unsigned mask;
+} arch_mpmc_ring_t;
+
+// size must be a power of 2
+static inline void arch_mpmc_init(arch_mpmc_ring_t *r, arch_mpmc_cell_t *cells, unsigned size)
+{
+    for (unsigned i = 0; i < size; ++i) {
+        atomic_set(&cells[i].seq, (int)i);
+        cells[i].data = NULL;
+    }
+    arch_ring_sync_out(cells, sizeof(*cells) * size);
+
+    atomic_set(&r->prod.pos, 0);
+    atomic_set(&r->cons.pos, 0);
+    atomic_set(&r->sleepers.prod, 0);
+    atomic_set(&r->sleepers.cons, 0);
+#if !PLF_ATOMIC_SUPPORTED
+    r->lock = (arch_lock_t)ARCH_LOCK_INIT(0);
+#endif // !PLF_ATOMIC_SUPPORTED
+    r->cells = cells;
+    r->mask = size - 1;
+    arch_ring_sync_out(r, sizeof(*r));
+}
+
+// positions and sequence numbers wrap around: unsigned arithmetic, the signed
+// distance is taken modulo 2^32 (arch_atomic_t holds an int)
+static inline unsigned arch_mpmc_read(const arch_atomic_t *v)
+{
+    return (unsigned)atomic_read(v);
+}
+
+static inline int arch_mpmc_dist(unsigned seq, unsigned pos)
+{
+    return (int)(seq - pos);
+}
+
+static inline bool arch_mpmc_push_nowake(arch_mpmc_ring_t *r, void *item)
+{
+    arch_mpmc_cell_t *cell;
+    unsigned pos = arch_mpmc_read(&r->prod.pos);
+
+    while (1) {
+        cell = &r->cells[pos & r->mask];
+
+        const int diff = arch_mpmc_dist(arch_mpmc_read(&cell->seq), pos);
+
+        if (diff == 0) {
+            if (atomic_cas(&r->prod.pos, (int)pos, (int)(pos + 1)))
+                break;
+            pos = arch_mpmc_read(&r->prod.pos);
+        } else if (diff < 0) {
+            return false; // full
+        } else {
+            pos = arch_mpmc_read(&r->prod.pos);
+        }
+    }
+
+    cell->data = item;
+    arch_ring_sync_out(&cell->data, sizeof(cell->data));
+    // data store is visible before the sequence
+    __asm__ __volatile__ ("fence rw , w\n" ::: "memory");
+    atomic_set(&cell->seq, (int)(pos + 1));
+
+    return true;
+}
+
+static inline bool arch_mpmc_pop_nowake(arch_mpmc_ring_t *r, void **item)
+{
+    arch_mpmc_cell_t *cell;
+    unsigned pos = arch_mpmc_read(&r->cons.pos);
+
+    while (1) {
+        cell = &r->cells[pos & r->mask];
+
+        const int diff = arch_mpmc_dist(arch_mpmc_read(&cell->seq), pos + 1);
+
+        if (diff == 0) {
+            if (atomic_cas(&r->cons.pos, (int)pos, (int)(pos + 1)))
+                break;
+            pos = arch_mpmc_read(&r->cons.pos);
+        } else if (diff < 0) {
+            return false; // empty
+        } else {
+            pos = arch_mpmc_read(&r->cons.pos);
+        }
+    }
+
+    // sequence load is ordered before the data load
+    __asm__ __volatile__ ("fence r , r\n" ::: "memory");
+    arch_ring_sync_in(&cell->data, sizeof(cell->data));
+    *item = cell->data;
+    // data load is done before the cell is given back to producers
+    __asm__ __volatile__ ("fence r , w\n" ::: "memory");
+    atomic_set(&cell->seq, (int)(pos + r->mask + 1));
+
+    return true;
+}
+
+static inline bool arch_mpmc_push(arch_mpmc_ring_t *r, void *item)
+{
+#if !PLF_ATOMIC_SUPPORTED
+    arch_lock(&r->lock);
+    const bool ret = arch_mpmc_push_nowake(r, item);
+    arch_unlock(&r->lock);
+#else
+    const bool ret = arch_mpmc_push_nowake(r, item);
+#endif // !PLF_ATOMIC_SUPPORTED
+
+    if (ret)
+        arch_ring_wake(&r->sleepers.cons);
+
+    return ret;
+}
+
+static inline bool arch_mpmc_pop(arch_mpmc_ring_t *r, void **item)
+{
+#if !PLF_ATOMIC_SUPPORTED
+    arch_lock(&r->lock);
+    const bool ret = arch_mpmc_pop_nowake(r, item);
+    arch_unlock(&r->lock);
+#else
+    const bool ret = arch_mpmc_pop_nowake(r, item);
+#endif // !PLF_ATOMIC_SUPPORTED
+
+    if (ret)
+        arch_ring_wake(&r->sleepers.prod);
+
+    return ret;
+}
+
+static inline bool arch_mpmc_not_full(void *p)
+{
+    arch_mpmc_ring_t *r = (arch_mpmc_ring_t*)p;
+    const unsigned pos = arch_mpmc_read(&r->prod.pos);
+
+    return arch_mpmc_dist(arch_mpmc_read(&r->cells[pos & r->mask].seq), pos) >= 0;
+}
+
+static inline bool arch_mpmc_not_empty(void *p)
+{
+    arch_mpmc_ring_t *r = (arch_mpmc_ring_t*)p;
+    const unsigned pos = arch_mpmc_read(&r->cons.pos);
+
+    return arch_mpmc_dist(arch_mpmc_read(&r->cells[pos & r->mask].seq), pos + 1) >= 0;
+}
+
+static inline void arch_mpmc_push_wait(arch_mpmc_ring_t *r, void *item)
+{
+    while (!arch_mpmc_push(r, item))
+        arch_ring_wait(&r->sleepers.prod, arch_mpmc_not_full, r);
+}
+
+static inline void *arch_mpmc_pop_wait(arch_mpmc_ring_t *r)
+{
+    void *item;
+
+    while (!arch_mpmc_pop(r, &item))
+        arch_ring_wait(&r->sleepers.cons, arch_mpmc_not_empty, r);
+
+    return item;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCR_BSP_RING_H
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief reader-writer lock defs and inlines
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#ifndef SCR_BSP_RWLOCK_H
+#define SCR_BSP_RWLOCK_H
+
+#include "arch.h"
+#include "lock.h"
+
+#ifdef PLF_SMP_SUPPORT
+
+#include "atomic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if PLF_ATOMIC_SUPPORTED
+
+/*
+ * Writer-preferring reader-writer spinlock.
+ * state holds the number of active readers and the writer bit,
+ * writers announce themselves in wwait and new readers stay out until
+ * the waiting writers are done.
+ * If PLF_RWLOCK_READER_BOUND is not 0, a reader lets at most that many
+ * writers pass before it ignores the waiting writers (bounded reader starvation).
+ */
+#ifndef PLF_RWLOCK_READER_BOUND
+#define PLF_RWLOCK_READER_BOUND (0)
+#endif
+
+#define ARCH_RWLOCK_WRITER (1 << 30)
+
+typedef struct arch_rwlock {
+    arch_atomic_t state;
+    arch_atomic_t wwait;
+#if PLF_RWLOCK_READER_BOUND
+    arch_atomic_t wgen; // number of write sections passed
+#endif // PLF_RWLOCK_READER_BOUND
+} arch_rwlock_t;
+
+#if PLF_RWLOCK_READER_BOUND
+# define ARCH_RWLOCK_INIT(i) { .state = ARCH_ATOMIC_INIT(0), .wwait = ARCH_ATOMIC_INIT(0), .wgen = ARCH_ATOMIC_INIT(0) }
+#else
+# define ARCH_RWLOCK_INIT(i) { .state = ARCH_ATOMIC_INIT(0), .wwait = ARCH_ATOMIC_INIT(0) }
+#endif // PLF_RWLOCK_READER_BOUND
+
+static inline int arch_read_trylock(arch_rwlock_t *lock)
+{
+    if (atomic_add(1, &lock->state) & ARCH_RWLOCK_WRITER) {
+        atomic_add(-1, &lock->state);
+        return 0;
+    }
+
+    // acquire barrier
+    __asm__ __volatile__ ("fence r , rw\n" ::: "memory");
+
+    return 1;
+}
+
+static inline void arch_read_lock(arch_rwlock_t *lock)
+{
+#if PLF_RWLOCK_READER_BOUND
+    const int gen = atomic_read(&lock->wgen);
+#endif // PLF_RWLOCK_READER_BOUND
+
+    while (1) {
+        arch_spin_until(&arch_spin_site_rwlock, !(atomic_read(&lock->state) & ARCH_RWLOCK_WRITER));
+
+        // writer preference
+        if (atomic_read(&lock->wwait)
+#if PLF_RWLOCK_READER_BOUND
+            && (atomic_read(&lock->wgen) - gen) < PLF_RWLOCK_READER_BOUND
+#endif // PLF_RWLOCK_READER_BOUND
+           ) {
+            arch_spin_pause();
+            continue;
+        }
+
+        if (arch_read_trylock(lock))
+            break;
+    }
+}
+
+static inline void arch_read_unlock(arch_rwlock_t *lock)
+{
+    // release barrier
+    __asm__ __volatile__ ("fence rw , w\n" ::: "memory");
+
+    if (atomic_add(-1, &lock->state) == 1)
+        arch_spin_wake(&arch_spin_site_rwlock);
+}
+
+static inline int arch_write_trylock(arch_rwlock_t *lock)
+{
+    int ret = atomic_cas(&lock->state, 0, ARCH_RWLOCK_WRITER);
+
+    // acquire barrier
+    __asm__ __volatile__ ("fence r , rw\n" ::: "memory");
+
+    return ret;
+}
+
+static inline void arch_write_lock(arch_rwlock_t *lock)
+{
+    atomic_add(1, &lock->wwait);
+
+    while (!arch_write_trylock(lock))
+        arch_spin_until(&arch_spin_site_rwlock, atomic_read(&lock->state) == 0);
+
+    atomic_add(-1, &lock->wwait);
+}
+
+static inline void arch_write_unlock(arch_rwlock_t *lock)
+{
+#if PLF_RWLOCK_READER_BOUND
+    atomic_add(1, &lock->wgen);
+#endif // PLF_RWLOCK_READER_BOUND
+
+    // release barrier
+    __asm__ __volatile__ ("fence rw , w\n" ::: "memory");
+
+    atomic_add(-ARCH_RWLOCK_WRITER, &lock->state);
+    arch_spin_wake(&arch_spin_site_rwlock);
+}
+
+static inline int arch_rwlock_is_locked(arch_rwlock_t *lock)
+{
+    return atomic_read(&lock->state) != 0;
+}
+
+#else // PLF_ATOMIC_SUPPORTED
+
+// no AMO: readers are serialized by the generic lock
+typedef struct arch_rwlock {
+    arch_lock_t lock;
+} arch_rwlock_t;
+
+#define ARCH_RWLOCK_INIT(i) { .lock = ARCH_LOCK_INIT(i) }
+
+static inline int arch_read_trylock(arch_rwlock_t *lock) { return arch_trylock(&lock->lock); }
+static inline void arch_read_lock(arch_rwlock_t *lock) { arch_lock(&lock->lock); }
+static inline void arch_read_unlock(arch_rwlock_t *lock) { arch_unlock(&lock->lock); }
+static inline int arch_write_trylock(arch_rwlock_t *lock) { return arch_trylock(&lock->lock); }
+static inline void arch_write_lock(arch_rwlock_t *lock) { arch_lock(&lock->lock); }
+static inline void arch_write_unlock(arch_rwlock_t *lock) { arch_unlock(&lock->lock); }
+static inline int arch_rwlock_is_locked(arch_rwlock_t *lock) { return arch_is_locked(&lock->lock); }
+
+#endif // PLF_ATOMIC_SUPPORTED
+
+#ifdef __cplusplus
+}
+#endif
+
+#else // PLF_SMP_SUPPORT
+
+typedef struct arch_rwlock {
+} arch_rwlock_t;
+
+#define ARCH_RWLOCK_INIT(i) {}
+
+#define arch_rwlock_is_locked(x) (0)
+
+static inline int arch_read_trylock(arch_rwlock_t *lock)
+{
+    (void)lock;
+
+    return 1;
+}
+
+static inline void arch_read_lock(arch_rwlock_t *lock)
+{
+    (void)lock;
+}
+
+static inline void arch_read_unlock(arch_rwlock_t *lock)
+{
+    (void)lock;
+}
+
+static inline int arch_write_trylock(arch_rwlock_t *lock)
+{
+    (void)lock;
+
+    return 1;
+}
+
+static inline void arch_write_lock(arch_rwlock_t *lock)
+{
+    (void)lock;
+}
+
+static inline void arch_write_unlock(arch_rwlock_t *lock)
+{
+    (void)lock;
+}
+
+#endif // PLF_SMP_SUPPORT
+
+#endif // SCR_BSP_RWLOCK_H
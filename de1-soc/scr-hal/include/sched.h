@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Preemptive fixed-priority scheduler
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#ifndef SCR_BSP_SCHED_H
+#define SCR_BSP_SCHED_H
+
+#include "arch.h"
+#include "drivers/rtc.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Threads of a hart scheduled by fixed priority (0 - the highest), round robin
+ * with PLF_SCHED_SLICE_US time slices within a priority. Every hart started by
+ * hal_sched_start() has its own run queues and preempts its threads by its
+ * mtimecmp interrupt; a thread stays on the hart that created it.
+ * The context switch is done by hal_sched_trap_entry: the trap frame of crt0
+ * (context_save) is left on the thread stack, mstatus and the FP registers
+ * (only if mstatus.FS is Dirty) are kept in the thread.
+ * hal_sched_start() replaces mtvec of the hart, the other traps are passed to
+ * trap_handler(). The scheduler owns the mtimer interrupt of the hart; platforms
+ * with the single SCR mtimer comparator (no PLF_MTIMER_EXT) run it on hart 0 only.
+ * The thread calls must not be used from the interrupt handlers.
+ */
+#ifndef PLF_SCHED_PRIORITIES
+#define PLF_SCHED_PRIORITIES (8)
+#endif
+
+#ifndef PLF_SCHED_SLICE_US
+#define PLF_SCHED_SLICE_US (1000)
+#endif
+
+#ifndef PLF_SCHED_STACK_SIZE
+#define PLF_SCHED_STACK_SIZE (2048)
+#endif
+
+#if PLF_SCHED_PRIORITIES > __riscv_xlen
+#error PLF_SCHED_PRIORITIES must not exceed XLEN
+#endif
+
+typedef struct hal_thread hal_thread_t;
+typedef void (*hal_thread_fn_t)(void *arg);
+
+typedef struct hal_sched_stat {
+    unsigned long switches;
+    unsigned long preemptions;  // switches by the timer: slice end or a woken thread
+    unsigned long ticks;        // timer interrupts
+    // context switch latency: cycles from the trap handler entry to the new context
+    uint64_t switch_min;
+    uint64_t switch_max;
+    uint64_t switch_sum;        // switch_sum / switches - the mean
+    // timer interrupt lateness vs the programmed mtimecmp, mtimer ticks
+    sys_tick_t jitter_min;
+    sys_tick_t jitter_max;
+} hal_sched_stat_t;
+
+// start scheduling on the calling hart, the caller continues as a thread of priority prio
+// returns 0, -EINVAL (bad priority), -ENOMEM (no idle thread) or
+// -ENODEV (single SCR mtimer comparator and the hart is not hart 0)
+int hal_sched_start(unsigned prio);
+// stack_size == 0: PLF_SCHED_STACK_SIZE; the thread is queued on the calling hart
+// returns NULL if out of memory or prio is out of range
+hal_thread_t *hal_thread_create(hal_thread_fn_t fn, void *arg, unsigned prio, size_t stack_size);
+// let the other ready threads of the same priority run; no-op before hal_sched_start()
+void hal_sched_yield(void);
+// sleep until rtc_now() >= t; busy-waits before hal_sched_start()
+void hal_sched_sleep_until(sys_tick_t t);
+// wait for the thread to return and free it, only by a thread of the same hart
+// returns 0, -EINVAL (another hart or before hal_sched_start()) or -EBUSY (joined already)
+int hal_thread_join(hal_thread_t *thread);
+hal_thread_t *hal_thread_self(void);
+// statistics of the calling hart
+void hal_sched_get_stat(hal_sched_stat_t *stat);
+
+static inline void hal_sched_sleep(sys_tick_t ticks)
+{
+    hal_sched_sleep_until(rtc_now() + ticks);
+}
+
+// trap entry installed by hal_sched_start()
+void hal_sched_trap_entry(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCR_BSP_SCHED_H
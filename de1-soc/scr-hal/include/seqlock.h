@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief sequence lock defs and inlines
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#ifndef SCR_BSP_SEQLOCK_H
+#define SCR_BSP_SEQLOCK_H
+
+#include "arch.h"
+#include "drivers/cache.h"
+#include "spin.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Sequence lock: the writer never waits, readers retry if the data
+ * has been changed while they were reading it.
+ * The sequence is odd while a write is in progress.
+ * Writers must be serialized by the caller (single writer or an external lock).
+ *
+ * read side:
+ *     do {
+ *         seq = arch_seq_read_begin(&sl);
+ *         copy = data;
+ *     } while (arch_seq_read_retry(&sl, seq));
+ *
+ * On PLF_SMP_NON_COHERENT platforms use the *_range() variants,
+ * which also write back / invalidate the protected data, and keep
+ * the sequence and the data in separate cache lines.
+ */
+typedef struct arch_seqlock {
+    volatile unsigned seq;
+} arch_seqlock_t;
+
+#define ARCH_SEQLOCK_INIT(i) { .seq = 0 }
+
+static inline void arch_seq_sync_out(const volatile void *p, size_t size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_flush((void*)p, (long)size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static inline void arch_seq_sync_in(const volatile void *p, size_t size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)p, (long)size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static inline void arch_seq_write_begin(arch_seqlock_t *sl)
+{
+    sl->seq = sl->seq + 1;
+    arch_seq_sync_out(&sl->seq, sizeof(sl->seq));
+    // odd sequence is visible before the data stores
+    __asm__ __volatile__ ("fence w , w\n" ::: "memory");
+}
+
+static inline void arch_seq_write_end_range(arch_seqlock_t *sl, const volatile void *data, size_t size)
+{
+    arch_seq_sync_out(data, size);
+    // data stores are visible before the even sequence
+    __asm__ __volatile__ ("fence w , w\n" ::: "memory");
+    sl->seq = sl->seq + 1;
+    arch_seq_sync_out(&sl->seq, sizeof(sl->seq));
+    arch_spin_wake(&arch_spin_site_seqlock);
+}
+
+static inline void arch_seq_write_end(arch_seqlock_t *sl)
+{
+    arch_seq_write_end_range(sl, NULL, 0);
+}
+
+static inline unsigned arch_seq_read_begin_range(const arch_seqlock_t *sl, const volatile void *data, size_t size)
+{
+    unsigned seq;
+
+    arch_spin_until(&arch_spin_site_seqlock,
+                    (arch_seq_sync_in(&sl->seq, sizeof(sl->seq)), seq = sl->seq, !(seq & 1)));
+
+    // sequence load is ordered before the data loads
+    __asm__ __volatile__ ("fence r , r\n" ::: "memory");
+    arch_seq_sync_in(data, size);
+
+    return seq;
+}
+
+static inline unsigned arch_seq_read_begin(const arch_seqlock_t *sl)
+{
+    return arch_seq_read_begin_range(sl, NULL, 0);
+}
+
+// returns non-zero if the data read after arch_seq_read_begin*() may be torn
+static inline int arch_seq_read_retry(const arch_seqlock_t *sl, unsigned seq)
+{
+    // data loads are ordered before the sequence load
+    __asm__ __volatile__ ("fence r , r\n" ::: "memory");
+    arch_seq_sync_in(&sl->seq, sizeof(sl->seq));
+
+    return sl->seq != seq;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCR_BSP_SEQLOCK_H
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Fixed-size object pools (slab allocator)
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+
+#ifndef SCR_BSP_SLAB_H
+#define SCR_BSP_SLAB_H
+
+#include "arch.h"
+#include "lock.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Pools of fixed-size objects.
+ * The objects are aligned to the cache line (PLF_CACHELINE_SIZE) and carved from
+ * a caller-provided region or from sbrk(). Every hart has a magazine of up to
+ * PLF_SLAB_MAGAZINE_SIZE free objects: hal_slab_alloc()/hal_slab_free() work on it
+ * with the interrupts disabled and without locks, a half of the magazine is refilled from
+ * (or returned to) the shared pool under its lock. Both operations are O(1).
+ * The objects cached in the magazines of other harts are not available to the hart:
+ * size the pool with (harts - 1) * PLF_SLAB_MAGAZINE_SIZE objects of reserve.
+ * The objects are not written back on PLF_SMP_NON_COHERENT platforms, the counters of
+ * the other harts are written back when they refill or drain their magazines.
+ */
+#ifndef PLF_SLAB_MAGAZINE_SIZE
+#define PLF_SLAB_MAGAZINE_SIZE (16)
+#endif
+
+#ifdef PLF_CACHELINE_SIZE
+#define HAL_SLAB_ALIGN PLF_CACHELINE_SIZE
+#else
+#define HAL_SLAB_ALIGN 16
+#endif
+
+#ifdef PLF_SMP_SUPPORT
+#define HAL_SLAB_HARTS PLF_SMP_HART_NUM
+#else
+#define HAL_SLAB_HARTS 1
+#endif // PLF_SMP_SUPPORT
+
+#ifdef PLF_MAX_CACHELINE_SIZE
+#define HAL_SLAB_LINE __attribute__((aligned(PLF_MAX_CACHELINE_SIZE)))
+#else
+#define HAL_SLAB_LINE __attribute__((aligned(64)))
+#endif
+
+typedef struct hal_slab_stat {
+    unsigned long allocs;     // successful allocations
+    unsigned long frees;
+    unsigned long failures;   // allocations failed: the pool is exhausted
+    unsigned long in_use;     // allocated objects (allocs - frees)
+    unsigned long high_water; // max number of objects taken from the pool by the harts
+} hal_slab_stat_t;
+
+// owner hart only
+typedef struct hal_slab_mag {
+    unsigned count;
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long failures;
+    void *obj[PLF_SLAB_MAGAZINE_SIZE];
+} HAL_SLAB_LINE hal_slab_mag_t;
+
+typedef struct hal_slab {
+    size_t obj_size;
+    unsigned long capacity;
+    struct {
+        arch_lock_t lock;
+        void *free;          // free objects list
+        char *next;          // objects never allocated
+        char *end;
+        unsigned long out;   // objects outside the shared pool
+        unsigned long high_water;
+    } HAL_SLAB_LINE pool;
+    hal_slab_mag_t mag[HAL_SLAB_HARTS];
+} hal_slab_t;
+
+// region size for count objects of obj_size bytes
+#define HAL_SLAB_OBJ_SIZE(obj_size) \
+    (((obj_size) + HAL_SLAB_ALIGN - 1) / HAL_SLAB_ALIGN * HAL_SLAB_ALIGN)
+#define HAL_SLAB_REGION_SIZE(obj_size, count) \
+    (HAL_SLAB_OBJ_SIZE(obj_size) * (count) + HAL_SLAB_ALIGN - 1)
+
+// region == NULL: the objects are taken from sbrk()
+// returns 0, -EINVAL (bad size or the region is too small), -ENOMEM (sbrk() failed)
+int hal_slab_init(hal_slab_t *slab, size_t obj_size, unsigned long count, void *region, size_t region_size);
+// returns NULL if the pool is exhausted
+void *hal_slab_alloc(hal_slab_t *slab);
+void hal_slab_free(hal_slab_t *slab, void *obj);
+void hal_slab_get_stat(hal_slab_t *slab, hal_slab_stat_t *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCR_BSP_SLAB_H
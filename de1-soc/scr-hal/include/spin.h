@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief spin-wait policies
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+#ifndef SCR_BSP_SPIN_H
+#define SCR_BSP_SPIN_H
+
+#include "arch.h"
+#include "atomic.h"
+#include "drivers/cache.h"
+#include "drivers/ipi.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Spin-wait policies:
+ * ARCH_SPIN_RELAX   - cpu_relax() between polls (fixed delay)
+ * ARCH_SPIN_PAUSE   - Zihintpause pause hint (cpu_relax() without Zihintpause)
+ * ARCH_SPIN_BACKOFF - exponential backoff from PLF_SPIN_BACKOFF_MIN to PLF_SPIN_BACKOFF_MAX cycles
+ * ARCH_SPIN_WFI     - backoff, after PLF_SPIN_WFI_CYCLES the hart sleeps in WFI
+ *                     until arch_spin_wake() sends it an IPI; requires IPI and AMO,
+ *                     the hart must have called ipi_init() (otherwise backoff is used)
+ * Every wait site (arch_spin_site_t) has its own max policy, the effective policy
+ * is the lower one of the site and PLF_SPIN_POLICY: sites without a waker never sleep.
+ * The default is ARCH_SPIN_RELAX: a platform (or an application build) raises
+ * PLF_SPIN_POLICY to let the sites back off or sleep.
+ * With PLF_SPIN_STATS the number of waits, polls, sleeps and the wait cycles
+ * are counted per site and per hart.
+ */
+#define ARCH_SPIN_RELAX   0
+#define ARCH_SPIN_PAUSE   1
+#define ARCH_SPIN_BACKOFF 2
+#define ARCH_SPIN_WFI     3
+
+#ifndef PLF_SPIN_POLICY
+#define PLF_SPIN_POLICY ARCH_SPIN_RELAX
+#endif
+
+#ifndef PLF_SPIN_BACKOFF_MIN
+#define PLF_SPIN_BACKOFF_MIN (16)
+#endif
+
+#ifndef PLF_SPIN_BACKOFF_MAX
+#define PLF_SPIN_BACKOFF_MAX (1024)
+#endif
+
+#ifndef PLF_SPIN_WFI_CYCLES
+#define PLF_SPIN_WFI_CYCLES (16 * 1024)
+#endif
+
+#ifndef PLF_SPIN_STATS
+#define PLF_SPIN_STATS (0)
+#endif
+
+#if (PLF_SPIN_POLICY >= ARCH_SPIN_WFI) && PLF_IPI_SUPPORT && PLF_ATOMIC_SUPPORTED
+#define ARCH_SPIN_WFI_SUPPORTED 1
+#else
+#define ARCH_SPIN_WFI_SUPPORTED 0
+#endif
+
+#ifdef PLF_SMP_SUPPORT
+#define ARCH_SPIN_HARTS PLF_SMP_HART_NUM
+#else
+#define ARCH_SPIN_HARTS 1
+#endif // PLF_SMP_SUPPORT
+
+#ifdef PLF_MAX_CACHELINE_SIZE
+#define ARCH_SPIN_ALIGN __attribute__((aligned(PLF_MAX_CACHELINE_SIZE)))
+#else
+#define ARCH_SPIN_ALIGN __attribute__((aligned(64)))
+#endif
+
+typedef struct arch_spin_stat {
+    unsigned long waits;  // waits that had to poll at least once
+    unsigned long polls;  // arch_spin_wait() calls
+    unsigned long sleeps; // WFI entries
+    uint64_t cycles;      // total wait cycles
+    uint64_t max_cycles;  // longest wait
+} arch_spin_stat_t;
+
+typedef struct arch_spin_site {
+    const char *name;
+    int policy;
+#if ARCH_SPIN_WFI_SUPPORTED
+    arch_atomic_t sleepers; // mask of the harts sleeping on the site
+#endif // ARCH_SPIN_WFI_SUPPORTED
+#if PLF_SPIN_STATS
+    // written by the owner hart only
+    struct {
+        arch_spin_stat_t s;
+    } ARCH_SPIN_ALIGN stat[ARCH_SPIN_HARTS];
+#endif // PLF_SPIN_STATS
+} arch_spin_site_t;
+
+#define ARCH_SPIN_SITE_INIT(n, p) \
+    { .name = (n), .policy = ((p) < PLF_SPIN_POLICY ? (p) : PLF_SPIN_POLICY) }
+
+// HAL wait sites
+extern arch_spin_site_t arch_spin_site_lock;     // arch_lock(), arch_unlock_wait()
+extern arch_spin_site_t arch_spin_site_mcs;      // arch_mcs_lock()/arch_mcs_unlock()
+extern arch_spin_site_t arch_spin_site_rwlock;   // arch_read_lock()/arch_write_lock()
+extern arch_spin_site_t arch_spin_site_seqlock;  // arch_seq_read_begin()
+extern arch_spin_site_t arch_spin_site_barrier;  // arch_barrier_wait()/arch_dbarrier_wait()
+extern arch_spin_site_t arch_spin_site_ring;     // *_push_wait()/*_pop_wait() without PLF_RING_WFI
+extern arch_spin_site_t arch_spin_site_ipi;      // ipi_cache_op() acknowledgements
+extern arch_spin_site_t arch_spin_site_smp;      // secondary harts start/finish
+extern arch_spin_site_t arch_spin_site_rtc;      // rtc_delay_ticks()
+extern arch_spin_site_t arch_spin_site_wait;     // hal_wait_on() without IPI
+
+extern arch_spin_site_t *const arch_spin_sites[];
+extern const unsigned arch_spin_site_count;
+
+void arch_spin_get_stat(const arch_spin_site_t *site, unsigned hart, arch_spin_stat_t *stat);
+
+typedef struct arch_spin {
+    arch_spin_site_t *site;
+    unsigned delay;
+#if PLF_SPIN_STATS || ARCH_SPIN_WFI_SUPPORTED
+    uint64_t start;
+#endif
+#if PLF_SPIN_STATS
+    unsigned long polls;
+    unsigned long sleeps;
+#endif // PLF_SPIN_STATS
+#if ARCH_SPIN_WFI_SUPPORTED
+    unsigned long mstatus;
+    int armed;
+#endif // ARCH_SPIN_WFI_SUPPORTED
+} arch_spin_t;
+
+static inline unsigned arch_spin_self(void)
+{
+#ifdef PLF_SMP_SUPPORT
+    return (unsigned)(arch_hartid() - PLF_SMP_HARTID_BASE);
+#else
+    return 0;
+#endif // PLF_SMP_SUPPORT
+}
+
+static inline void arch_spin_pause(void)
+{
+#ifdef __riscv_zihintpause
+    // pause: fence w, 0
+    __asm__ __volatile__ (".insn i 0x0f, 0, x0, x0, 0x010" ::: "memory");
+#else
+    cpu_relax();
+#endif
+}
+
+static inline void arch_spin_begin(arch_spin_t *s, arch_spin_site_t *site)
+{
+    s->site = site;
+    s->delay = PLF_SPIN_BACKOFF_MIN;
+#if PLF_SPIN_STATS || ARCH_SPIN_WFI_SUPPORTED
+    s->start = arch_cycle();
+#endif
+#if PLF_SPIN_STATS
+    s->polls = 0;
+    s->sleeps = 0;
+#endif // PLF_SPIN_STATS
+#if ARCH_SPIN_WFI_SUPPORTED
+    s->armed = 0;
+#endif // ARCH_SPIN_WFI_SUPPORTED
+}
+
+#if ARCH_SPIN_WFI_SUPPORTED
+static inline void arch_spin_disarm(arch_spin_t *s)
+{
+    atomic_add_seq_cst(-(1 << arch_spin_self()), &s->site->sleepers);
+    // take the pending IPI
+    set_csr(mstatus, s->mstatus & MSTATUS_MIE);
+    s->armed = 0;
+}
+#endif // ARCH_SPIN_WFI_SUPPORTED
+
+// one poll interval, the caller re-checks its condition after it
+static inline void arch_spin_wait(arch_spin_t *s)
+{
+#if PLF_SPIN_STATS
+    s->polls++;
+#endif // PLF_SPIN_STATS
+
+    switch (s->site->policy) {
+    case ARCH_SPIN_RELAX:
+        cpu_relax();
+        break;
+    case ARCH_SPIN_PAUSE:
+        arch_spin_pause();
+        break;
+    default:
+#if ARCH_SPIN_WFI_SUPPORTED
+        if (s->site->policy == ARCH_SPIN_WFI) {
+            if (s->armed) {
+                // the condition has been re-checked after the hart was registered
+                wfi();
+#if PLF_SPIN_STATS
+                s->sleeps++;
+#endif // PLF_SPIN_STATS
+                arch_spin_disarm(s);
+                break;
+            }
+#if PLF_IPI_IMSIC
+            const unsigned long ipi_mie = MIE_MEXTERNAL;
+#else
+            const unsigned long ipi_mie = MIE_MSOFTWARE;
+#endif
+            if ((arch_cycle() - s->start) >= PLF_SPIN_WFI_CYCLES && (read_csr(mie) & ipi_mie)) {
+                // register as a sleeper, interrupts stay pending until disarm
+                s->mstatus = clear_csr(mstatus, MSTATUS_MIE);
+                atomic_or_seq_cst(1 << arch_spin_self(), &s->site->sleepers);
+                s->armed = 1;
+                break;
+            }
+        }
+#endif // ARCH_SPIN_WFI_SUPPORTED
+        {
+            const uint64_t t0 = arch_cycle();
+            while ((arch_cycle() - t0) < s->delay)
+                arch_spin_pause();
+            if (s->delay < PLF_SPIN_BACKOFF_MAX)
+                s->delay <<= 1;
+        }
+        break;
+    }
+}
+
+static inline void arch_spin_end(arch_spin_t *s)
+{
+#if ARCH_SPIN_WFI_SUPPORTED
+    if (s->armed)
+        arch_spin_disarm(s);
+#endif // ARCH_SPIN_WFI_SUPPORTED
+
+#if PLF_SPIN_STATS
+    arch_spin_stat_t *st = &s->site->stat[arch_spin_self()].s;
+    const uint64_t cycles = arch_cycle() - s->start;
+
+    st->waits++;
+    st->polls += s->polls;
+    st->sleeps += s->sleeps;
+    st->cycles += cycles;
+    if (cycles > st->max_cycles)
+        st->max_cycles = cycles;
+#if PLF_SMP_NON_COHERENT
+    cache_l1_flush(st, sizeof(*st));
+#endif // PLF_SMP_NON_COHERENT
+#else
+    (void)s;
+#endif // PLF_SPIN_STATS
+}
+
+// wake up the harts sleeping on the site, call after the condition has been changed
+static inline void arch_spin_wake(arch_spin_site_t *site)
+{
+#if ARCH_SPIN_WFI_SUPPORTED
+    if (site->policy == ARCH_SPIN_WFI) {
+        fence();
+
+        unsigned mask = (unsigned)atomic_read(&site->sleepers);
+
+        for (unsigned h = 0; mask; ++h, mask >>= 1) {
+            if (mask & 1)
+                ipi_send(h);
+        }
+    }
+#else
+    (void)site;
+#endif // ARCH_SPIN_WFI_SUPPORTED
+}
+
+// spin on the site until cond is true, the condition is evaluated before the first wait
+#define arch_spin_until(site, cond)          \
+    do {                                     \
+        if (!(cond)) {                       \
+            arch_spin_t spin__;              \
+            arch_spin_begin(&spin__, (site)); \
+            do {                             \
+                arch_spin_wait(&spin__);     \
+            } while (!(cond));               \
+            arch_spin_end(&spin__);          \
+        }                                    \
+    } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCR_BSP_SPIN_H
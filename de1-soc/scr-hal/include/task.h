@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Work-stealing task scheduler
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+
+#ifndef SCR_BSP_TASK_H
+#define SCR_BSP_TASK_H
+
+#include "arch.h"
+#include "atomic.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Work-stealing task scheduler.
+ * Every hart owns a Chase-Lev deque of PLF_TASK_DEQUE_SIZE tasks in hart-local
+ * storage: hal_task_spawn() pushes to the bottom of the caller's deque,
+ * the owner pops from the bottom, idle harts steal from the top of a randomly
+ * chosen victim. hal_task_sync() runs local and stolen tasks until all tasks of
+ * the group are done. Secondary harts serve tasks in hal_task_worker() (called
+ * from PLF_SMP_SLAVE_ENTRY), after PLF_TASK_IDLE_SPINS failed steal rounds a worker
+ * sleeps in hal_wait_on() until a new task is spawned or hal_task_shutdown().
+ * The task function and arguments are not written back: on PLF_SMP_NON_COHERENT
+ * platforms the task data must be flushed by the spawner and the task.
+ * Without SMP or AMO support tasks are executed by hal_task_spawn() inline.
+ */
+#ifndef PLF_TASK_DEQUE_SIZE
+#define PLF_TASK_DEQUE_SIZE (256)
+#endif
+
+#ifndef PLF_TASK_IDLE_SPINS
+#define PLF_TASK_IDLE_SPINS (64)
+#endif
+
+typedef void (*hal_task_fn_t)(void *arg);
+
+typedef struct hal_task_group {
+    arch_atomic_t pending;
+} hal_task_group_t;
+
+#define HAL_TASK_GROUP_INIT {ARCH_ATOMIC_INIT(0)}
+
+typedef struct hal_task_stat {
+    unsigned long tasks;  // tasks executed by the hart
+    unsigned long steals; // tasks stolen from other harts
+    uint64_t idle_cycles; // cycles spent without a task in hal_task_sync()/hal_task_worker()
+} hal_task_stat_t;
+
+static inline void hal_task_group_init(hal_task_group_t *g)
+{
+    atomic_set(&g->pending, 0);
+}
+
+// runs the task inline if the deque is full
+void hal_task_spawn(hal_task_group_t *g, hal_task_fn_t fn, void *arg);
+// executes tasks until all tasks of the group are done
+void hal_task_sync(hal_task_group_t *g);
+// serves tasks until hal_task_shutdown()
+void hal_task_worker(void);
+void hal_task_shutdown(void);
+// hart number relative to PLF_SMP_HARTID_BASE
+void hal_task_get_stat(unsigned hart, hal_task_stat_t *stat);
+
+#ifdef __cplusplus
+}
+
+namespace hal {
+
+// spawned callables are referenced, not copied: they must outlive sync()
+class task_group {
+public:
+    task_group() { hal_task_group_init(&group_); }
+    ~task_group() { sync(); }
+
+    task_group(const task_group &) = delete;
+    task_group &operator=(const task_group &) = delete;
+
+    template <typename F>
+    void spawn(F &f) { hal_task_spawn(&group_, &task_group::call<F>, &f); }
+
+    void sync() { hal_task_sync(&group_); }
+
+private:
+    template <typename F>
+    static void call(void *f) { (*static_cast<F *>(f))(); }
+
+    hal_task_group_t group_;
+};
+
+} // namespace hal
+
+#endif // __cplusplus
+
+#endif // SCR_BSP_TASK_H
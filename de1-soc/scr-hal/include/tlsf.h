@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief TLSF (Two-Level Segregated Fit) allocator
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+
+#ifndef SCR_BSP_TLSF_H
+#define SCR_BSP_TLSF_H
+
+#include "arch.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * TLSF allocator: free blocks are kept in segregated lists indexed by two bitmap
+ * levels (power of 2 ranges split into 2^PLF_TLSF_SL_LOG2 linear sub-ranges),
+ * a suitable list is found by two find-first-set operations, freed blocks are
+ * immediately merged with free neighbours: malloc/free/realloc/memalign take
+ * bounded time independent of the heap state. The heap is global and protected
+ * by a lock. It starts empty and grows by pools of at least PLF_TLSF_GROW_SIZE
+ * bytes taken from sbrk(), hal_tlsf_add_pool() adds a caller-provided region.
+ * Blocks are 16 bytes aligned with a 16 bytes header.
+ * With HAL_MALLOC=tlsf malloc() and friends are implemented by the allocator.
+ * PLF_TLSF_CHECK=1 validates the neighbours of every freed or resized block,
+ * hal_tlsf_corruption() (weak, aborts by default) is called on a failed check.
+ * The heap metadata is not written back on PLF_SMP_NON_COHERENT platforms:
+ * allocate and free on a single hart there.
+ */
+#ifndef PLF_TLSF_SL_LOG2
+#define PLF_TLSF_SL_LOG2 (4)
+#endif
+
+#ifndef PLF_TLSF_GROW_SIZE
+#define PLF_TLSF_GROW_SIZE (64 * 1024)
+#endif
+
+#ifndef PLF_TLSF_MAX_POOLS
+#define PLF_TLSF_MAX_POOLS (8)
+#endif
+
+#ifndef PLF_TLSF_CHECK
+#define PLF_TLSF_CHECK (0)
+#endif
+
+typedef struct hal_tlsf_stat {
+    size_t total;          // pools size
+    size_t used;           // allocated blocks, including headers
+    size_t peak_used;
+    size_t free;           // free blocks, excluding headers
+    size_t max_free_block; // largest free block
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long failures; // allocations failed
+    unsigned pools;
+} hal_tlsf_stat_t;
+
+void *hal_tlsf_malloc(size_t size);
+void hal_tlsf_free(void *ptr);
+void *hal_tlsf_realloc(void *ptr, size_t size);
+void *hal_tlsf_calloc(size_t n, size_t size);
+// align is a power of 2
+void *hal_tlsf_memalign(size_t align, size_t size);
+size_t hal_tlsf_usable_size(const void *ptr);
+
+// returns 0 or -EINVAL (too small region or too many pools)
+int hal_tlsf_add_pool(void *mem, size_t size);
+
+// full heap walk: returns 0 or -EFAULT if the heap structure is broken
+int hal_tlsf_check(void);
+// calls fn for every block of the heap
+typedef void (*hal_tlsf_walker_t)(void *ptr, size_t size, int used, void *ctx);
+void hal_tlsf_walk(hal_tlsf_walker_t fn, void *ctx);
+// walks the heap to count free memory
+void hal_tlsf_get_stat(hal_tlsf_stat_t *stat);
+
+/*
+ * Heaps in fixed memory regions (no growth): the control structure (about 4 KiB) is placed
+ * at the beginning of the region. Returns NULL if the region is too small.
+ */
+typedef struct hal_tlsf_heap hal_tlsf_heap_t;
+hal_tlsf_heap_t *hal_tlsf_create(void *mem, size_t size);
+void *hal_tlsf_heap_memalign(hal_tlsf_heap_t *heap, size_t align, size_t size);
+void hal_tlsf_heap_free(hal_tlsf_heap_t *heap, void *ptr);
+int hal_tlsf_heap_check(hal_tlsf_heap_t *heap);
+void hal_tlsf_heap_walk(hal_tlsf_heap_t *heap, hal_tlsf_walker_t fn, void *ctx);
+void hal_tlsf_heap_get_stat(hal_tlsf_heap_t *heap, hal_tlsf_stat_t *stat);
+
+// integrity check failure hook, ptr - the block being freed or resized
+void hal_tlsf_corruption(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCR_BSP_TLSF_H
@@ -49,6 +49,21 @@ extern uint64_t bss_complete_cycles;
 
 static inline __attribute__((always_inline)) uint64_t get_bss_complete_cycles() { return bss_complete_cycles; }
 
+// boot phases duration (cycles)
+extern uint64_t boot_cache_init_cycles;
+extern uint64_t boot_bss_init_cycles;
+extern uint64_t boot_bss_wait_cycles;
+extern uint64_t boot_tls_init_cycles;
+
+static inline __attribute__((always_inline)) uint64_t get_boot_cache_init_cycles() { return boot_cache_init_cycles; }
+static inline __attribute__((always_inline)) uint64_t get_boot_bss_init_cycles() { return boot_bss_init_cycles; }
+// HAL_PARALLEL_BSS_INIT: part of bss init spent waiting for the secondary harts
+static inline __attribute__((always_inline)) uint64_t get_boot_bss_wait_cycles() { return boot_bss_wait_cycles; }
+// TLS init and stack allocation of all harts by the master hart
+static inline __attribute__((always_inline)) uint64_t get_boot_tls_init_cycles() { return boot_tls_init_cycles; }
+// HAL_PARALLEL_BSS_INIT: BSS slice clear cycles of the hart (number relative to PLF_SMP_HARTID_BASE)
+uint64_t get_boot_bss_hart_cycles(unsigned hart);
+
 void* OPT_NONE memset_optnone(void *dest, int ch, size_t count);
 
 int hal_get_sysinfo(char* buf, size_t len, bool extended_output);
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief futex-style wait/wake on memory words
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+#ifndef SCR_BSP_WAIT_H
+#define SCR_BSP_WAIT_H
+
+#include "arch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Futex-style wait/wake.
+ * hal_wait_on() puts the calling hart to sleep while *addr == expected,
+ * hal_wake() wakes up to n harts waiting on addr by IPI. Waiters are
+ * registered in a small hashed table, only the registered harts are interrupted.
+ * The waker must update the word (and write it back on PLF_SMP_NON_COHERENT
+ * platforms, e.g. by atomic_set()) before hal_wake().
+ * Sleeping requires IPI support and ipi_init() on the waiting hart,
+ * otherwise the hart polls its wakeup flag.
+ */
+#ifndef PLF_WAIT_TABLE_SIZE
+#define PLF_WAIT_TABLE_SIZE (16)
+#endif
+
+#define HAL_WAKE_ALL (~0U)
+
+// returns 0 when woken up, -EAGAIN if *addr != expected on entry
+int hal_wait_on(const volatile int *addr, int expected);
+// returns the number of woken up harts
+unsigned hal_wake(const volatile int *addr, unsigned n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCR_BSP_WAIT_H
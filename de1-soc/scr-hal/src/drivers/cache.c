@@ -30,6 +30,7 @@
 #include "drivers/cache.h"
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #ifdef PLF_CACHE_CFG
 static int cacheinfo2str(char* buf, size_t len, unsigned long info)
@@ -87,17 +88,19 @@ void cache_l1_invalidate(void* vaddr, long size)
         register uintptr_t a0 = (uintptr_t)vaddr;
         /* take in account alignment of vaddr,
            invalidate next after last cache line too if needed */
-        size += a0 & (PLF_CACHELINE_SIZE - 1);
+        size += a0 & (CACHE_OP_BLOCK_SIZE - 1);
         do {
-#ifdef INSN_NOT_SUPPORTED
+#if defined(__riscv_zicbom)
+            asm volatile("cbo.inval (%[rs1])" :: [rs1]"r"(a0) : "memory");
+#elif defined(INSN_NOT_SUPPORTED)
             asm volatile(".equ code_clinv, "STRINGIFY(ENC_CLINV(10))";"
                          "mv a0, %0; .word code_clinv;" ::"r"(a0) : "a0");
 #else
             asm volatile(".insn i SYSTEM, 0, zero, %[rs1], 0b000100001000"
                          :: [rs1]"r"(a0) : "memory");
-#endif // INSN_NOT_SUPPORTED
-            a0 += PLF_CACHELINE_SIZE;
-            size -= PLF_CACHELINE_SIZE;
+#endif // __riscv_zicbom
+            a0 += CACHE_OP_BLOCK_SIZE;
+            size -= CACHE_OP_BLOCK_SIZE;
         } while (size > 0);
     }
 #else
@@ -114,18 +117,20 @@ void cache_l1_flush(void* vaddr, long size)
         register uintptr_t a0 = (uintptr_t)vaddr;
         /* take in account alignment of vaddr,
            flush next after last cache line too if needed */
-        size += a0 & (PLF_CACHELINE_SIZE - 1);
+        size += a0 & (CACHE_OP_BLOCK_SIZE - 1);
         /* Flush the cache for the requested range */
         do {
-#ifdef INSN_NOT_SUPPORTED
+#if defined(__riscv_zicbom)
+            asm volatile("cbo.flush (%[rs1])" :: [rs1]"r"(a0) : "memory");
+#elif defined(INSN_NOT_SUPPORTED)
             asm volatile(".equ code_clflush, "STRINGIFY(ENC_CLFLUSH(10))";"
                          "mv a0, %0; .word code_clflush;" ::"r"(a0) : "a0");
 #else
             asm volatile(".insn i SYSTEM, 0, zero, %[rs1], 0b000100001001"
                          :: [rs1]"r"(a0) : "memory");
-#endif // INSN_NOT_SUPPORTED
-            a0 += PLF_CACHELINE_SIZE;
-            size -= PLF_CACHELINE_SIZE;
+#endif // __riscv_zicbom
+            a0 += CACHE_OP_BLOCK_SIZE;
+            size -= CACHE_OP_BLOCK_SIZE;
         } while (size > 0);
     }
 
@@ -136,6 +141,53 @@ void cache_l1_flush(void* vaddr, long size)
 #endif // PLF_CACHE_CFG
 }
 
+void cache_l1_clean(void* vaddr, long size)
+{
+#if defined(__riscv_zicbom) && PLF_CACHE_CFG
+    if (size)
+    {
+        register uintptr_t a0 = (uintptr_t)vaddr;
+        /* take in account alignment of vaddr,
+           clean next after last cache line too if needed */
+        size += a0 & (CACHE_OP_BLOCK_SIZE - 1);
+        do {
+            asm volatile("cbo.clean (%[rs1])" :: [rs1]"r"(a0) : "memory");
+            a0 += CACHE_OP_BLOCK_SIZE;
+            size -= CACHE_OP_BLOCK_SIZE;
+        } while (size > 0);
+    }
+
+    fence();
+#else
+    // no clean-only custom op: write back and invalidate
+    cache_l1_flush(vaddr, size);
+#endif // __riscv_zicbom && PLF_CACHE_CFG
+}
+
+void* cache_memset(void* dst, int c, size_t size)
+{
+#if PLF_CACHE_CBOZ_SUPPORT
+    if (c == 0 && size >= CACHE_ZERO_MIN_SIZE)
+    {
+        char* p = (char*)dst;
+        const size_t head = (size_t)(-(uintptr_t)p & (PLF_CBOZ_BLOCK_SIZE - 1));
+
+        memset(p, 0, head);
+        p += head;
+        size -= head;
+
+        for (; size >= PLF_CBOZ_BLOCK_SIZE; size -= PLF_CBOZ_BLOCK_SIZE, p += PLF_CBOZ_BLOCK_SIZE)
+            asm volatile("cbo.zero (%0)" :: "r"(p) : "memory");
+
+        memset(p, 0, size);
+
+        return dst;
+    }
+#endif // PLF_CACHE_CBOZ_SUPPORT
+
+    return memset(dst, c, size);
+}
+
 int plf_l1cache_prefetcher_info(char *buf, size_t len)
 {
     int ssz = 0;
@@ -232,10 +284,10 @@ int cache_l1d_info(char* buf, size_t len)
     return sz0;
 }
 
-void plf_l2cache_enable(void)
+void plf_l2cache_init_start(void)
 {
 #if PLF_L2CTL_BASE
-    // init L2$: disable, confirm  state, invalidate, confirm, enable, confirm
+    // disable, confirm state, start invalidation
     volatile uint32_t* const l2ctl = (volatile uint32_t*)PLF_L2CTL_BASE;
 
     if (!l2ctl[L2_CSR_VER_IDX])
@@ -252,6 +304,22 @@ void plf_l2cache_enable(void)
         ;
     // invalidate
     l2ctl[L2_CSR_INV_IDX] = cbmask;
+#endif // PLF_L2CTL_BASE
+}
+
+void plf_l2cache_init_finish(void)
+{
+#if PLF_L2CTL_BASE
+    // confirm invalidation, enable, confirm
+    volatile uint32_t* const l2ctl = (volatile uint32_t*)PLF_L2CTL_BASE;
+
+    if (!l2ctl[L2_CSR_VER_IDX])
+        return; // cache not exists or not supported
+
+    uint32_t cbmask = l2ctl[L2_CSR_DESCR_IDX];
+
+    cbmask = (1U << (((cbmask >> 16) & 0xf) + 1)) - 1;
+
     // confirm state
     while (l2ctl[L2_CSR_BUSY_IDX])
         ;
@@ -270,6 +338,13 @@ void plf_l2cache_enable(void)
 #endif // PLF_L2CTL_BASE
 }
 
+void plf_l2cache_enable(void)
+{
+    // init L2$: disable, confirm  state, invalidate, confirm, enable, confirm
+    plf_l2cache_init_start();
+    plf_l2cache_init_finish();
+}
+
 void plf_l2cache_disable(void)
 {
 #if PLF_L2CTL_BASE
@@ -378,28 +453,48 @@ int cache_l2_info(char* buf, size_t len)
 #endif // PLF_L2CTL_BASE
 }
 
-void plf_l3cache_init(void)
+void plf_l3cache_init_start(void)
 {
 #if PLF_L3CTL_BASE
     volatile uint64_t* const l3ctl = (volatile uint64_t*)PLF_L3CTL_BASE;
 
-    const uint64_t l3_ver = l3ctl[L3C_VID_IDX];
-
-    if (!l3_ver)
+    if (!l3ctl[L3C_VID_IDX])
         return;
 
     // Invalidate all banks
     l3ctl[L3C_CMD_CTRL_IDX] = (L3C_MASK << 8) | L3C_CMD_OPCODE_INVALID;
+#endif // PLF_L3CTL_BASE
+}
+
+void plf_l3cache_init_wait(void)
+{
+#if PLF_L3CTL_BASE
+    volatile uint64_t* const l3ctl = (volatile uint64_t*)PLF_L3CTL_BASE;
+
+    if (!l3ctl[L3C_VID_IDX])
+        return;
 
     const unsigned banks = (l3ctl[L3C_DESCR_CACHE_IDX] >> 8) & L3C_MASK;
 
-    for (unsigned b = 0; b < banks; b++)
-    {
-        while (!(l3ctl[L3B_STEP * (b + 1) + L3B_CMD_STS] & L3B_CMD_STS_DONE));
-    }
+    // banks work in parallel, poll all of them until the last one is done
+    bool busy;
+    do {
+        busy = false;
+        for (unsigned b = 0; b < banks; b++)
+        {
+            if (!(l3ctl[L3B_STEP * (b + 1) + L3B_CMD_STS] & L3B_CMD_STS_DONE))
+                busy = true;
+        }
+    } while (busy);
 #endif // PLF_L3CTL_BASE
 }
 
+void plf_l3cache_init(void)
+{
+    plf_l3cache_init_start();
+    plf_l3cache_init_wait();
+}
+
 int cache_l3_info(char* buf, size_t len)
 {
 #if PLF_L3CTL_BASE
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2015, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Microarchitecture feature profiles implementation
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2015, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#include "drivers/feature_profile.h"
+
+#include "arch.h"
+
+#include <stdio.h>
+
+static __thread plf_feature_profile_stat_t profile_stat;
+
+// collect the knobs available on the current hart
+static void plf_feature_profile_avail(plf_feature_profile_t* avail)
+{
+    avail->feature_mask = 0;
+    avail->l1d_debug_mask = 0;
+    avail->l1d_prefetcher_mask = 0;
+
+    if (plf_bpu_early_branch_resolution_is_available())
+        avail->feature_mask |= BPU_EARLY_BRANCH_RESOLUTION_BIT;
+    if (plf_bpu_loop_predictor_is_available())
+        avail->feature_mask |= BPU_LOOP_PREDICTOR_ENABLE_BIT;
+    if (plf_l1cache_store_merge_is_available())
+        avail->feature_mask |= L1D_STORE_MERGE_ENABLE_BIT;
+    if (plf_l1icache_prefetcher_is_available())
+        avail->feature_mask |= L1I_PREFETCHER_ENABLE_BIT;
+    if (plf_page_prefetcher_is_available())
+        avail->feature_mask |= PAGE_PREFETCHER_ENABLE_BIT;
+    if (plf_misaligned_access_is_available())
+        avail->feature_mask |= MISALIGNED_ACCESS_ENABLE_BIT;
+
+    if (plf_l1cache_spec_ld_is_available())
+        avail->l1d_debug_mask |= L1D_DEBUG_SPEC_LD_DISABLE_BIT;
+    if (plf_l1cache_spec_ld_over_st_is_available())
+        avail->l1d_debug_mask |= L1D_DEBUG_SPEC_LD_OVER_ST_DISABLE_BIT;
+    if (plf_l1cache_lsdp_is_available())
+        avail->l1d_debug_mask |= L1D_DEBUG_LSDP_DISABLE_BIT;
+
+    if (plf_l1cache_prefetcher_is_available())
+        avail->l1d_prefetcher_mask = L1D_PREFETCHER_ENABLE_BIT | L1D_PREFETCHER_PARAMS_MASK;
+}
+
+// Update the masked bits of CSR with the minimal number of writes:
+// one csrrs for bits to be set and one csrrc for bits to be cleared
+#define FEATURE_PROFILE_CSR_UPDATE(csr, mask, value, saved_value, writes) \
+do {                                                                      \
+    if (mask) {                                                           \
+        const unsigned long __cur  = read_csr(csr);                       \
+        const unsigned long __diff = (__cur ^ (value)) & (mask);          \
+        (saved_value) = __cur & (mask);                                   \
+        if (__diff & (value)) {                                           \
+            set_csr(csr, __diff & (value));                               \
+            ++(writes);                                                   \
+        }                                                                 \
+        if (__diff & ~(value)) {                                          \
+            clear_csr(csr, __diff & ~(value));                            \
+            ++(writes);                                                   \
+        }                                                                 \
+    }                                                                     \
+} while (0)
+
+void plf_feature_profile_capture(plf_feature_profile_t* profile, const char* name)
+{
+    plf_feature_profile_avail(profile);
+
+    profile->name = name;
+    profile->feature_value = 0;
+    profile->l1d_debug_value = 0;
+    profile->l1d_prefetcher_value = 0;
+
+    if (profile->feature_mask)
+        profile->feature_value = read_csr(SCR_CSR_FEATURE_ENABLE) & profile->feature_mask;
+    if (profile->l1d_debug_mask)
+        profile->l1d_debug_value = read_csr(L1D_DEBUG_OPTIONS) & profile->l1d_debug_mask;
+    if (profile->l1d_prefetcher_mask)
+        profile->l1d_prefetcher_value = read_csr(L1D_PREFETCHER_CTRL_REG_0) & profile->l1d_prefetcher_mask;
+}
+
+int plf_feature_profile_apply(const plf_feature_profile_t* profile, plf_feature_profile_t* saved)
+{
+    const uint64_t start = arch_cycle();
+
+    plf_feature_profile_t avail;
+    plf_feature_profile_avail(&avail);
+
+    const unsigned long feature_mask   = profile->feature_mask & avail.feature_mask;
+    const unsigned long l1d_debug_mask = profile->l1d_debug_mask & avail.l1d_debug_mask;
+    const unsigned long l1d_pref_mask  = profile->l1d_prefetcher_mask & avail.l1d_prefetcher_mask;
+
+    unsigned long feature_value = 0;
+    unsigned long l1d_debug_value = 0;
+    unsigned long l1d_pref_value = 0;
+    int writes = 0;
+
+    FEATURE_PROFILE_CSR_UPDATE(SCR_CSR_FEATURE_ENABLE, feature_mask,
+                               profile->feature_value, feature_value, writes);
+    FEATURE_PROFILE_CSR_UPDATE(L1D_DEBUG_OPTIONS, l1d_debug_mask,
+                               profile->l1d_debug_value, l1d_debug_value, writes);
+    FEATURE_PROFILE_CSR_UPDATE(L1D_PREFETCHER_CTRL_REG_0, l1d_pref_mask,
+                               profile->l1d_prefetcher_value, l1d_pref_value, writes);
+
+    if (saved) {
+        saved->name = NULL;
+        saved->feature_mask = feature_mask;
+        saved->feature_value = feature_value;
+        saved->l1d_debug_mask = l1d_debug_mask;
+        saved->l1d_debug_value = l1d_debug_value;
+        saved->l1d_prefetcher_mask = l1d_pref_mask;
+        saved->l1d_prefetcher_value = l1d_pref_value;
+    }
+
+    const unsigned long cycles = (unsigned long)(arch_cycle() - start);
+
+    profile_stat.switches++;
+    profile_stat.csr_writes += (unsigned long)writes;
+    profile_stat.last_cycles = cycles;
+    profile_stat.total_cycles += cycles;
+    if (cycles > profile_stat.max_cycles)
+        profile_stat.max_cycles = cycles;
+
+    return writes;
+}
+
+bool plf_feature_profile_is_active(const plf_feature_profile_t* profile)
+{
+    plf_feature_profile_t cur;
+    plf_feature_profile_capture(&cur, NULL);
+
+    return ((cur.feature_value ^ profile->feature_value) & profile->feature_mask & cur.feature_mask) == 0
+        && ((cur.l1d_debug_value ^ profile->l1d_debug_value) & profile->l1d_debug_mask & cur.l1d_debug_mask) == 0
+        && ((cur.l1d_prefetcher_value ^ profile->l1d_prefetcher_value)
+            & profile->l1d_prefetcher_mask & cur.l1d_prefetcher_mask) == 0;
+}
+
+const plf_feature_profile_stat_t* plf_feature_profile_stat(void)
+{
+    return &profile_stat;
+}
+
+void plf_feature_profile_stat_reset(void)
+{
+    profile_stat.switches = 0;
+    profile_stat.csr_writes = 0;
+    profile_stat.last_cycles = 0;
+    profile_stat.max_cycles = 0;
+    profile_stat.total_cycles = 0;
+}
+
+int plf_feature_profile_info(const plf_feature_profile_t* profile, char* buf, size_t len)
+{
+    return snprintf(buf, len, "%s: feature %08lx/%08lx, l1d debug %08lx/%08lx, l1d prefetcher %08lx/%08lx",
+                    profile->name ? profile->name : "(unnamed)",
+                    profile->feature_value, profile->feature_mask,
+                    profile->l1d_debug_value, profile->l1d_debug_mask,
+                    profile->l1d_prefetcher_value, profile->l1d_prefetcher_mask);
+}
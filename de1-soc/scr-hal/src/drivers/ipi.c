@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2015, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Inter-processor interrupts and cross-hart cache maintenance
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2015, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#include "drivers/ipi.h"
+
+#include "arch.h"
+#include "drivers/cache.h"
+#include "hart_local.h"
+#include "lock.h"
+#include "spin.h"
+
+#if PLF_IPI_CLINT
+#include "drivers/clint.h"
+#elif PLF_IPI_IMSIC
+#include "drivers/aia.h"
+#elif PLF_IPI_ICCM
+#include "drivers/iccm_l3.h"
+#include "iccm_lock.h"
+#endif
+
+static void ipi_cache_op_local(unsigned op, void *addr, long size)
+{
+    switch (op) {
+    case IPI_CACHE_L1_FLUSH:
+        cache_l1_flush(addr, size);
+        break;
+    case IPI_CACHE_L1_INVALIDATE:
+        cache_l1_invalidate(addr, size);
+        break;
+    case IPI_CACHE_L1_CLEAN:
+        cache_l1_clean(addr, size);
+        break;
+    case IPI_CACHE_FENCE_I:
+        fence();
+        ifence();
+        break;
+    default:
+        break;
+    }
+}
+
+#if PLF_IPI_SUPPORT
+
+// The request is written by the lock owner only, acknowledgements are written
+// by the targets: keep them in separate cache lines to avoid false sharing
+typedef struct {
+    volatile unsigned long seq;
+    volatile unsigned op;
+    void *volatile addr;
+    volatile long size;
+} __attribute__((aligned(PLF_MAX_CACHELINE_SIZE))) ipi_req_t;
+
+typedef struct {
+    volatile unsigned long seq;
+    volatile int ready;
+} __attribute__((aligned(PLF_MAX_CACHELINE_SIZE))) ipi_ack_t;
+
+static ipi_req_t ipi_req;
+static __hart_local ipi_ack_t ipi_ack;
+static arch_lock_t ipi_lock = ARCH_LOCK_INIT(0);
+
+static inline unsigned ipi_self(void)
+{
+    return (unsigned)(arch_hartid() - PLF_SMP_HARTID_BASE);
+}
+
+static inline void ipi_sync_out(volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_flush((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+    fence();
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static inline void ipi_sync_in(volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+    fence();
+#endif // PLF_SMP_NON_COHERENT
+}
+
+void ipi_send(unsigned hart)
+{
+    fence();
+#if PLF_IPI_CLINT
+    clint_msip_set(hart);
+#elif PLF_IPI_IMSIC
+    imsic_set_seteipnum_le(IMSIC_M, hart, PLF_IMSIC_IPI_ID);
+#elif PLF_IPI_ICCM
+    // the receiver has not consumed the previous message yet:
+    // the pending interrupt serves both requests
+    if (!iccm_l3_receiver_busy(iccm_l3_get_own_id(), (iccm_l3_id)hart))
+        iccm_l3_write_msg((iccm_l3_id)hart, 1);
+#endif
+}
+
+void ipi_clear(void)
+{
+#if PLF_IPI_CLINT
+    clint_msip_clear(ipi_self());
+#elif PLF_IPI_IMSIC
+    // claim the top interrupt
+    swap_csr(IMSIC_CSR_MTOPEI, 0);
+#elif PLF_IPI_ICCM
+    // the messages of the ICCM lock service are dispatched, not dropped
+    (void)iccm_lock_pump();
+#endif
+    fence();
+}
+
+void ipi_init(void)
+{
+    const unsigned self = ipi_self();
+
+#if PLF_IPI_IMSIC
+    imsic_set_eienum(IMSIC_M, PLF_IMSIC_IPI_ID);
+    imsic_write(IMSIC_M, IMSIC_EIDELIVERY, 1);
+    swap_csr(IMSIC_CSR_MTOPEI, 0);
+    set_csr(mie, MIE_MEXTERNAL);
+#else
+    ipi_clear();
+    set_csr(mie, MIE_MSOFTWARE);
+#endif
+
+    ipi_ack_t *ack = hart_local_ptr(ipi_ack, self);
+
+    ack->seq = ipi_req.seq;
+    ack->ready = 1;
+    ipi_sync_out(ack, sizeof(*ack));
+
+    set_csr(mstatus, MSTATUS_MIE);
+}
+
+bool ipi_trap_handler(unsigned long mcause)
+{
+#if PLF_IPI_IMSIC
+    if (mcause != (TRAP_CAUSE_INTERRUPT_FLAG | TRAP_CAUSE_INT_MEXT)
+        || imsic_topei_identity(read_csr(IMSIC_CSR_MTOPEI)) != PLF_IMSIC_IPI_ID)
+        return false;
+#else
+    if (mcause != (TRAP_CAUSE_INTERRUPT_FLAG | TRAP_CAUSE_INT_MSOFT))
+        return false;
+#endif
+
+    // clear before reading the request to not lose the next one
+    ipi_clear();
+
+    const unsigned self = ipi_self();
+
+    ipi_sync_in(&ipi_req, sizeof(ipi_req));
+
+    const unsigned long seq = ipi_req.seq;
+
+    ipi_ack_t *ack = hart_local_ptr(ipi_ack, self);
+
+    if (ack->seq != seq) {
+        ipi_cache_op_local(ipi_req.op, ipi_req.addr, ipi_req.size);
+        ack->seq = seq;
+        ipi_sync_out(ack, sizeof(*ack));
+    }
+
+    return true;
+}
+
+int ipi_cache_op(unsigned long hart_mask, unsigned op, void *addr, long size)
+{
+    const unsigned self = ipi_self();
+    unsigned long sent = 0;
+    int skipped = 0;
+
+    arch_lock(&ipi_lock);
+
+    const unsigned long seq = ipi_req.seq + 1;
+
+    ipi_req.op = op;
+    ipi_req.addr = addr;
+    ipi_req.size = size;
+    ipi_req.seq = seq;
+    ipi_sync_out(&ipi_req, sizeof(ipi_req));
+
+    for (unsigned h = 0; h < PLF_SMP_HART_NUM; ++h) {
+        if (h == self || !(hart_mask & (1UL << h)))
+            continue;
+        ipi_ack_t *ack = hart_local_ptr(ipi_ack, h);
+
+        ipi_sync_in(ack, sizeof(*ack));
+        if (!ack->ready) {
+            // ipi_init() was not called by the hart
+            ++skipped;
+            continue;
+        }
+        ipi_send(h);
+        sent |= 1UL << h;
+    }
+
+    if (hart_mask & (1UL << self))
+        ipi_cache_op_local(op, addr, size);
+
+    for (unsigned h = 0; h < PLF_SMP_HART_NUM; ++h) {
+        if (!(sent & (1UL << h)))
+            continue;
+        ipi_ack_t *ack = hart_local_ptr(ipi_ack, h);
+
+        arch_spin_until(&arch_spin_site_ipi, (ipi_sync_in(ack, sizeof(*ack)), ack->seq == seq));
+    }
+
+    arch_unlock(&ipi_lock);
+
+    return skipped;
+}
+
+#else // PLF_IPI_SUPPORT
+
+void ipi_send(unsigned hart) { (void)hart; }
+void ipi_clear(void) {}
+void ipi_init(void) {}
+
+bool ipi_trap_handler(unsigned long mcause)
+{
+    (void)mcause;
+    return false;
+}
+
+int ipi_cache_op(unsigned long hart_mask, unsigned op, void *addr, long size)
+{
+#if PLF_SMP_SUPPORT
+    const unsigned self = (unsigned)(arch_hartid() - PLF_SMP_HARTID_BASE);
+    // the other harts can not be reached
+    const int ret = (hart_mask & ~(1UL << self)) ? -1 : 0;
+#else
+    const unsigned self = 0;
+    const int ret = 0;
+#endif // PLF_SMP_SUPPORT
+
+    if (hart_mask & (1UL << self))
+        ipi_cache_op_local(op, addr, size);
+
+    return ret;
+}
+
+#endif // PLF_IPI_SUPPORT
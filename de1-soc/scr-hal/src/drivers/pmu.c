@@ -33,6 +33,7 @@
 #include "drivers/pmu.h"
 
 #include "arch.h"
+#include "hart_local.h"
 #include "perf.h"
 #include "utils.h"
 
@@ -222,8 +223,11 @@ static const pmuc_descriptor_t pmuc_descriptors[] = {
 #define PMUC_CSR_MHPMEVENT_OF (1UL << 63)
 #define PMUC_BIT(x) (1UL << (x))
 
+// the selected events are global, the CSR counters and their snapshots are per hart
 __attribute__((section (".data")))
-static pmuc_counter_t pmu_csr_counters[PMUC_MAX_CSR_EVENT_COUNT];
+static size_t pmu_csr_ids[PMUC_MAX_CSR_EVENT_COUNT];
+
+static __hart_local uint64_t pmu_csr_values[PMUC_MAX_CSR_EVENT_COUNT];
 
 __attribute__((section (".data")))
 unsigned long pmuc_csr_counters_mask = 0;
@@ -502,7 +506,7 @@ void pmuc_setup_selected_counters(void)
     for (size_t i = 0; i < pmuc_selected_csr_counters_num; i++) {
         pmuc_write_csr_counter(i, 0);
 
-        const size_t id = pmu_csr_counters[i].id;
+        const size_t id = pmu_csr_ids[i];
         pmuc_setup_csr_counter(i, pmuc_descriptors[id].selector | PMUC_CSR_MHPMEVENT_OF);
     }
 
@@ -555,7 +559,7 @@ size_t pmuc_get_selected_counters_num(void)
 uint64_t pmuc_get_counter_value(size_t index)
 {
     if (index < pmuc_selected_csr_counters_num)
-        return pmu_csr_counters[index].value;
+        return (*this_hart_local(pmu_csr_values))[index];
 #ifdef PLF_L2CTL_BASE
     if (index < (pmuc_selected_csr_counters_num + pmuc_selected_l2_counters_num))
         return pmu_l2_counters[index - pmuc_selected_csr_counters_num].value;
@@ -565,7 +569,7 @@ uint64_t pmuc_get_counter_value(size_t index)
         return pmu_l3_counters[index - pmuc_selected_csr_counters_num - pmuc_selected_l2_counters_num].value;
 #endif // PLF_L3CTL_BASE
 
-    return pmu_csr_counters[index].value;
+    return (*this_hart_local(pmu_csr_values))[index];
 }
 
 const char* pmuc_get_counter_name(size_t index)
@@ -581,7 +585,7 @@ const char* pmuc_get_counter_name(size_t index)
         id = pmu_l2_counters[index - pmuc_selected_csr_counters_num].id;
 #endif // PLF_L2CTL_BASE
     if (index < pmuc_selected_csr_counters_num)
-        id = pmu_csr_counters[index].id;
+        id = pmu_csr_ids[index];
 
     return pmuc_descriptors[id].name;
 }
@@ -623,14 +627,14 @@ int pmuc_add_counter(const char* name)
 #endif // PLF_L3CTL_BASE
     {
         for (size_t i = 0; i < pmuc_selected_csr_counters_num; i++) {
-            if (pmu_csr_counters[i].id == id) {
+            if (pmu_csr_ids[i] == id) {
                 return PMUC_R_DUPLICATE_ID;
             }
         }
         if (pmuc_selected_csr_counters_num == pmuc_get_available_csr_counters_num()) {
             return PMUC_R_CSR_COUNTERS_LIMIT;
         }
-        pmu_csr_counters[pmuc_selected_csr_counters_num++].id = id;
+        pmu_csr_ids[pmuc_selected_csr_counters_num++] = id;
     }
 
     return PMUC_R_OK;
@@ -639,7 +643,7 @@ int pmuc_add_counter(const char* name)
 void pmuc_update_counters(void)
 {
     for (size_t i = 0; i < pmuc_selected_csr_counters_num; i++) {
-        pmu_csr_counters[i].value = pmuc_read_csr_counter(i);
+        (*this_hart_local(pmu_csr_values))[i] = pmuc_read_csr_counter(i);
     }
 
 #ifdef PLF_L2CTL_BASE
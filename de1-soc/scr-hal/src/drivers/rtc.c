@@ -70,8 +70,8 @@ unsigned long rtc_dyn_hart_clock_rate(void)
     do {
         // reduce the number of rtc_now() calls
         for (int i = 0; i < 64; ++i) {
-            cpu_relax();
-            cpu_relax();
+            arch_spin_pause();
+            arch_spin_pause();
         }
     } while ((rtc_now() - t) < ticks);
 
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief malloc() family on top of the HAL heap allocators
+///
+/// Syntacore SCR* framework
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#include "heap.h"
+#include "tlsf.h"
+
+#include <stddef.h>
+#include <sys/errno.h>
+
+// newlib reentrant entry points: the reent structure is not used
+struct _reent;
+
+#if defined(HAL_MALLOC_ARENAS)
+
+#define hal_malloc_impl(s)          hal_arena_malloc(s)
+#define hal_free_impl(p)            hal_arena_free(p)
+#define hal_realloc_impl(p, s)      hal_arena_realloc((p), (s))
+#define hal_calloc_impl(n, s)       hal_arena_calloc((n), (s))
+#define hal_memalign_impl(a, s)     hal_arena_memalign((a), (s))
+#define hal_usable_size_impl(p)     hal_arena_usable_size(p)
+
+#elif defined(HAL_MALLOC_TLSF)
+
+#define hal_malloc_impl(s)          hal_tlsf_malloc(s)
+#define hal_free_impl(p)            hal_tlsf_free(p)
+#define hal_realloc_impl(p, s)      hal_tlsf_realloc((p), (s))
+#define hal_calloc_impl(n, s)       hal_tlsf_calloc((n), (s))
+#define hal_memalign_impl(a, s)     hal_tlsf_memalign((a), (s))
+#define hal_usable_size_impl(p)     hal_tlsf_usable_size(p)
+
+#endif // HAL_MALLOC_ARENAS
+
+void *malloc(size_t size)
+{
+    return hal_malloc_impl(size);
+}
+
+void free(void *ptr)
+{
+    hal_free_impl(ptr);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    return hal_realloc_impl(ptr, size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    return hal_calloc_impl(n, size);
+}
+
+void *memalign(size_t align, size_t size)
+{
+    return hal_memalign_impl(align, size);
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+    return hal_memalign_impl(align, size);
+}
+
+int posix_memalign(void **ptr, size_t align, size_t size)
+{
+    if (!align || (align & (align - 1)) || (align % sizeof(void*)))
+        return EINVAL;
+
+    void *p = hal_memalign_impl(align, size);
+
+    if (!p)
+        return ENOMEM;
+
+    *ptr = p;
+
+    return 0;
+}
+
+size_t malloc_usable_size(void *ptr)
+{
+    return hal_usable_size_impl(ptr);
+}
+
+void *_malloc_r(struct _reent *r, size_t size)
+{
+    (void)r;
+    return hal_malloc_impl(size);
+}
+
+void _free_r(struct _reent *r, void *ptr)
+{
+    (void)r;
+    hal_free_impl(ptr);
+}
+
+void *_realloc_r(struct _reent *r, void *ptr, size_t size)
+{
+    (void)r;
+    return hal_realloc_impl(ptr, size);
+}
+
+void *_calloc_r(struct _reent *r, size_t n, size_t size)
+{
+    (void)r;
+    return hal_calloc_impl(n, size);
+}
+
+void *_memalign_r(struct _reent *r, size_t align, size_t size)
+{
+    (void)r;
+    return hal_memalign_impl(align, size);
+}
+
+size_t _malloc_usable_size_r(struct _reent *r, void *ptr)
+{
+    (void)r;
+    return hal_usable_size_impl(ptr);
+}
@@ -990,19 +990,27 @@ int fiprintf(__attribute__((unused)) FILE *file, const char * format, ...)
 
 
 // placed to section .data to support skip bss clear option for simulators */
+#if PLF_PRINTK_MCS_LOCK
+static __attribute__((section (".data"))) arch_mcs_lock_t printk_lock = ARCH_MCS_LOCK_INIT(0);
+#define printk_lock_acquire() arch_mcs_lock(&printk_lock)
+#define printk_lock_release() arch_mcs_unlock(&printk_lock)
+#else
 static __attribute__((section (".data"))) arch_lock_t printk_lock = ARCH_LOCK_INIT(0);
+#define printk_lock_acquire() arch_lock(&printk_lock)
+#define printk_lock_release() arch_unlock(&printk_lock)
+#endif // PLF_PRINTK_MCS_LOCK
 
 int printk(const char *fmt, ...)
 {
     va_list ap;
 
-    arch_lock(&printk_lock);
+    printk_lock_acquire();
 
     va_start(ap, fmt);
     const int i = vprintf(fmt, ap);
     va_end(ap);
 
-    arch_unlock(&printk_lock);
+    printk_lock_release();
 
     return i;
 }
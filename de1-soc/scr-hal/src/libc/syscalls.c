@@ -28,8 +28,10 @@
 /// See the License for the specific language governing permissions and
 /// limitations under the License.
 
+#include "atomic.h"
 #include "drivers/console.h"
 #include "drivers/rtc.h"
+#include "lock.h"
 #include "utils.h"
 
 #include <sys/errno.h>
@@ -207,71 +209,78 @@ int clock_getres(clockid_t clock_id, struct timespec *res)
 
 #endif /* HAL_ENABLE_SEMIHOST */
 
-struct sbrk_init_heap
+#if __riscv_xlen == 64
+typedef arch_atomic64_t sbrk_atomic_t;
+#define sbrk_read(v)         atomic64_read(v)
+#define sbrk_cas(v, cmp, n)  atomic64_cas_seq_cst((v), (long)(cmp), (long)(n))
+#else // __riscv_xlen == 64
+typedef arch_atomic_t sbrk_atomic_t;
+#define sbrk_read(v)         atomic_read(v)
+#define sbrk_cas(v, cmp, n)  atomic_cas_seq_cst((v), (int)(cmp), (int)(n))
+#endif // __riscv_xlen == 64
+
+#if PLF_SMP_SUPPORT && !PLF_ATOMIC_SUPPORTED
+// no AMO: the heap end update is serialized by the lock
+static __attribute__((section (".data"))) arch_lock_t sbrk_lock = ARCH_LOCK_INIT(0);
+#define sbrk_lock_acquire() arch_lock(&sbrk_lock)
+#define sbrk_lock_release() arch_unlock(&sbrk_lock)
+#else
+#define sbrk_lock_acquire() do {} while (0)
+#define sbrk_lock_release() do {} while (0)
+#endif // PLF_SMP_SUPPORT && !PLF_ATOMIC_SUPPORTED
+
+/* Defined by the linker */
+extern char _heap_start[];
+extern char _heap_end[];
+extern char _heap_end_div_offset[];
+extern char __TEXT_START__[];
+extern char _mem_origin[];
+extern char _heap_end_in_stack_offset[];
+
+// the end of the heap: computed from the linker symbols, the same for all harts
+static uintptr_t sbrk_heap_limit(void)
 {
-    uintptr_t cur_end;
-    uintptr_t sys_end;
-};
+    uintptr_t heap_end_in_stack = (uintptr_t)(_heap_end_in_stack_offset - __TEXT_START__);
+    uintptr_t effective_heap_end =
+        (((uintptr_t)_heap_end - (uintptr_t)_mem_origin) * (uintptr_t)(_heap_end_div_offset - __TEXT_START__) +
+         (uintptr_t)_mem_origin);
+#if PLF_TRAP_STACK
+    unsigned long stack_offset = (PLF_STACK_SIZE + PLF_TRAP_STACK + 16) * heap_end_in_stack;
+#else
+    unsigned long stack_offset = PLF_STACK_SIZE * heap_end_in_stack;
+#endif
 
+    return effective_heap_end - stack_offset;
+}
+
+// may be called by any hart: the heap end is advanced by CAS (by the lock without AMO)
 void* sbrk(ptrdiff_t incr)
 {
-    /* Defined by the linker */
-    extern char _heap_start[];
-    extern char _heap_end[];
-    extern char _heap_end_div_offset[];
-    extern char __TEXT_START__[];
-    extern char _mem_origin[];
-    extern char _heap_end_in_stack_offset[];
+    static __attribute__((section (".data"))) sbrk_atomic_t cur_heap_end = {0};
 
-    void* memblk;
+    const uintptr_t sys_heap_end = sbrk_heap_limit();
+    uintptr_t cur;
 
-    static __attribute__((section (".data"))) uintptr_t cur_heap_end = 0;
-    static __attribute__((section (".data"))) uintptr_t sys_heap_end = 0;
+    sbrk_lock_acquire();
 
-#if __riscv_xlen == 32
-    if (!cur_heap_end)
-    {
-        uintptr_t heap_end_in_stack = (uintptr_t)(_heap_end_in_stack_offset - __TEXT_START__);
-        uintptr_t effective_heap_end =
-            (((uintptr_t)_heap_end - (uintptr_t)_mem_origin) * (uintptr_t)(_heap_end_div_offset - __TEXT_START__) +
-             (uintptr_t)_mem_origin);
-        cur_heap_end = (uintptr_t)_heap_start;
-#if PLF_TRAP_STACK
-        unsigned long stack_offset = (PLF_STACK_SIZE + PLF_TRAP_STACK + 16) * heap_end_in_stack;
-#else
-        unsigned long stack_offset = PLF_STACK_SIZE * heap_end_in_stack;
-#endif
-        sys_heap_end = effective_heap_end - stack_offset;
-    }
-#else // __riscv_xlen == 32
+    // the first caller sets the heap start
+    if (!sbrk_read(&cur_heap_end))
+        sbrk_cas(&cur_heap_end, 0, (uintptr_t)_heap_start);
 
-    if (!cur_heap_end)
-    {
-        uintptr_t heap_end_in_stack = (uintptr_t)(_heap_end_in_stack_offset - __TEXT_START__);
-        struct sbrk_init_heap init  = {.cur_end = (uintptr_t)_heap_start,
-                                      .sys_end = ((uintptr_t)_heap_end - (uintptr_t)_mem_origin) *
-                                                     (uintptr_t)(_heap_end_div_offset - __TEXT_START__) +
-                                                 (uintptr_t)_mem_origin};
-        cur_heap_end               = init.cur_end;
-#if PLF_TRAP_STACK
-        unsigned long stack_offset  = (PLF_STACK_SIZE + PLF_TRAP_STACK + 16) * heap_end_in_stack;
-#else
-        unsigned long stack_offset = PLF_STACK_SIZE * heap_end_in_stack;
-#endif
-        sys_heap_end               = init.sys_end - stack_offset;
-    }
-#endif // __riscv_xlen == 32
+    do {
+        cur = (uintptr_t)sbrk_read(&cur_heap_end);
 
-    if (sys_heap_end - cur_heap_end < (size_t)incr)
-    {
-        /* Heap overflow */
-        return (void*)(-ENOMEM);
-    }
+        if (sys_heap_end - cur < (size_t)incr)
+        {
+            /* Heap overflow */
+            sbrk_lock_release();
+            return (void*)(-ENOMEM);
+        }
+    } while (!sbrk_cas(&cur_heap_end, cur, cur + (size_t)incr));
 
-    memblk = (void*)cur_heap_end;
-    cur_heap_end += (size_t)incr;
+    sbrk_lock_release();
 
-    return memblk;
+    return (void*)cur;
 }
 
 // __assert_func used by the assert() macro defined in <assert.h>
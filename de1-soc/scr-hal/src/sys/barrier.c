@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Centralized and dissemination hart barriers
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+#include "barrier.h"
+
+#include "arch.h"
+#include "drivers/cache.h"
+#include "spin.h"
+
+#include <string.h>
+#include <sys/errno.h>
+
+static inline unsigned barrier_self(void)
+{
+#ifdef PLF_SMP_SUPPORT
+    return (unsigned)(arch_hartid() - PLF_SMP_HARTID_BASE);
+#else
+    return 0;
+#endif // PLF_SMP_SUPPORT
+}
+
+static inline void barrier_sync_out(const volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_flush((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static inline void barrier_sync_in(const volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static void barrier_account(arch_barrier_hart_t *h, uint64_t start)
+{
+    const uint64_t wait = arch_cycle() - start;
+
+    h->stat.wait_cycles += wait;
+    if (wait > h->stat.max_wait_cycles)
+        h->stat.max_wait_cycles = wait;
+    h->stat.count++;
+    barrier_sync_out(h, sizeof(*h));
+}
+
+static void barrier_get_stat(const arch_barrier_hart_t *h, arch_barrier_stat_t *stat)
+{
+    barrier_sync_in(h, sizeof(*h));
+    *stat = h->stat;
+}
+
+//----------------------
+// centralized sense-reversing barrier
+//----------------------
+
+int arch_barrier_init(arch_barrier_t *b, unsigned nharts)
+{
+    if (!nharts || nharts > ARCH_BARRIER_HARTS)
+        return -EINVAL;
+
+    memset(b, 0, sizeof(*b));
+    b->nharts = nharts;
+    barrier_sync_out(b, sizeof(*b));
+
+    return 0;
+}
+
+// returns the number of harts arrived before the caller
+static int barrier_arrive(arch_barrier_t *b)
+{
+#if defined(PLF_SMP_SUPPORT) && !PLF_ATOMIC_SUPPORTED
+    arch_lock(&b->arrive.lock);
+    const int n = atomic_read(&b->arrive.count);
+    atomic_set(&b->arrive.count, n + 1);
+    arch_unlock(&b->arrive.lock);
+    return n;
+#else
+    return atomic_add_seq_cst(1, &b->arrive.count);
+#endif
+}
+
+void arch_barrier_wait(arch_barrier_t *b)
+{
+    const uint64_t start = arch_cycle();
+    arch_barrier_hart_t *h = &b->hart[barrier_self()];
+
+    // the sense can not change until this hart has arrived
+    barrier_sync_in(&b->release, sizeof(b->release));
+    const int sense = b->release.sense;
+
+    if (barrier_arrive(b) == (int)b->nharts - 1) {
+        atomic_set(&b->arrive.count, 0);
+        // the counter is reset before the waiters are released
+        __asm__ __volatile__ ("fence rw , w\n" ::: "memory");
+        b->release.sense = !sense;
+        barrier_sync_out(&b->release, sizeof(b->release));
+        arch_spin_wake(&arch_spin_site_barrier);
+    } else {
+        arch_spin_until(&arch_spin_site_barrier,
+                        (barrier_sync_in(&b->release, sizeof(b->release)), b->release.sense != sense));
+    }
+
+    // acquire barrier
+    __asm__ __volatile__ ("fence r , rw\n" ::: "memory");
+
+    barrier_account(h, start);
+}
+
+void arch_barrier_get_stat(const arch_barrier_t *b, unsigned hart, arch_barrier_stat_t *stat)
+{
+    barrier_get_stat(&b->hart[hart], stat);
+}
+
+//----------------------
+// dissemination barrier
+//----------------------
+
+int arch_dbarrier_init(arch_dbarrier_t *b, unsigned nharts)
+{
+    // the flags and the per-hart state are sized for ARCH_BARRIER_HARTS
+    if (!nharts || nharts > ARCH_BARRIER_HARTS)
+        return -EINVAL;
+
+    memset(b, 0, sizeof(*b));
+    b->nharts = nharts;
+    b->rounds = ARCH_BARRIER_LOG2_CEIL(nharts);
+    barrier_sync_out(b, sizeof(*b));
+
+    return 0;
+}
+
+void arch_dbarrier_wait(arch_dbarrier_t *b)
+{
+    const uint64_t start = arch_cycle();
+    const unsigned self = barrier_self();
+    arch_barrier_hart_t *h = &b->hart[self];
+    const unsigned long epoch = ++h->epoch;
+
+    for (unsigned k = 0; k < b->rounds; ++k) {
+        arch_dbarrier_flag_t *out = &b->flag[(self + (1U << k)) % b->nharts][k];
+        arch_dbarrier_flag_t *in = &b->flag[self][k];
+
+        // release barrier
+        __asm__ __volatile__ ("fence rw , w\n" ::: "memory");
+        out->epoch = epoch;
+        barrier_sync_out(out, sizeof(*out));
+        arch_spin_wake(&arch_spin_site_barrier);
+
+        // the partner may already be in the next episode: wait for "at least"
+        arch_spin_until(&arch_spin_site_barrier,
+                        (barrier_sync_in(in, sizeof(*in)), (long)(in->epoch - epoch) >= 0));
+    }
+
+    // acquire barrier
+    __asm__ __volatile__ ("fence r , rw\n" ::: "memory");
+
+    barrier_account(h, start);
+}
+
+void arch_dbarrier_get_stat(const arch_dbarrier_t *b, unsigned hart, arch_barrier_stat_t *stat)
+{
+    barrier_get_stat(&b->hart[hart], stat);
+}
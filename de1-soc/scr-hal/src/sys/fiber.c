@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Cooperative fibers
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#include "fiber.h"
+
+#include "arch.h"
+#include "hart_local.h"
+
+#include <malloc.h> /* memalign() */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/errno.h>
+
+#define FIBER_ALIGN    16
+#define FIBER_PATTERN  (0x5a5a5a5aUL * (~0UL / 0xffffffffUL))
+#define FIBER_HDR_SIZE ((sizeof(hal_fiber_t) + FIBER_ALIGN - 1) & ~(size_t)(FIBER_ALIGN - 1))
+
+#if (PLF_FIBER_GUARD_SIZE % FIBER_ALIGN) != 0
+#error PLF_FIBER_GUARD_SIZE must be a multiple of 16
+#endif
+
+struct hal_fiber {
+    hal_fiber_ctx_t ctx;
+    hal_fiber_t *next;      // run queue link
+    hal_fiber_fn_t fn;
+    void *arg;
+    unsigned long *stack;   // lowest address, the guard is at the bottom
+    size_t stack_size;
+    volatile bool done;
+};
+
+// owner hart only
+typedef struct {
+    hal_fiber_t root;       // the original context of the hart
+    hal_fiber_t *current;   // NULL: root
+    hal_fiber_t *head;      // run queue
+    hal_fiber_t *tail;
+    hal_fiber_stat_t stat;
+} fiber_hart_t;
+
+static __hart_local fiber_hart_t fiber_hart;
+
+void hal_fiber_start(void);
+void hal_fiber_main(hal_fiber_t *f) __attribute__((noreturn));
+
+__attribute__((weak)) void hal_fiber_stack_overflow(const hal_fiber_t *fiber)
+{
+    (void)fiber;
+    abort();
+}
+
+static inline hal_fiber_t *fiber_current(fiber_hart_t *h)
+{
+    return h->current ? h->current : &h->root;
+}
+
+static inline void fiber_enqueue(fiber_hart_t *h, hal_fiber_t *f)
+{
+    f->next = NULL;
+    if (h->tail)
+        h->tail->next = f;
+    else
+        h->head = f;
+    h->tail = f;
+}
+
+static inline hal_fiber_t *fiber_dequeue(fiber_hart_t *h)
+{
+    hal_fiber_t *f = h->head;
+
+    if (f) {
+        h->head = f->next;
+        if (!h->head)
+            h->tail = NULL;
+    }
+
+    return f;
+}
+
+static bool fiber_guard_ok(const hal_fiber_t *f)
+{
+    if (!f->stack)
+        return true;
+
+    for (unsigned i = 0; i < PLF_FIBER_GUARD_SIZE / sizeof(unsigned long); ++i) {
+        if (f->stack[i] != FIBER_PATTERN)
+            return false;
+    }
+
+    return true;
+}
+
+static void fiber_switch(fiber_hart_t *h, hal_fiber_t *from, hal_fiber_t *to)
+{
+#if PLF_FIBER_STACK_CHECK
+    if (!fiber_guard_ok(from))
+        hal_fiber_stack_overflow(from);
+#endif // PLF_FIBER_STACK_CHECK
+
+    h->current = (to == &h->root) ? NULL : to;
+    ++h->stat.switches;
+    hal_fiber_switch(&from->ctx, &to->ctx);
+}
+
+void hal_fiber_main(hal_fiber_t *f)
+{
+    f->fn(f->arg);
+    f->done = true;
+
+    // the contexts waiting for this one are queued: at least the root is
+    fiber_hart_t *h = this_hart_local(fiber_hart);
+    hal_fiber_t *next = fiber_dequeue(h);
+
+    if (!next)
+        abort();
+
+    fiber_switch(h, f, next);
+    __builtin_unreachable();
+}
+
+hal_fiber_t *hal_fiber_create(hal_fiber_fn_t fn, void *arg, size_t stack_size)
+{
+    if (!stack_size)
+        stack_size = PLF_FIBER_STACK_SIZE;
+    stack_size = (stack_size + FIBER_ALIGN - 1) & ~(size_t)(FIBER_ALIGN - 1);
+    if (stack_size < PLF_FIBER_GUARD_SIZE + 2 * HAL_FIBER_FRAME_SIZE) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    hal_fiber_t *f = memalign(FIBER_ALIGN, FIBER_HDR_SIZE + stack_size);
+
+    if (!f)
+        return NULL;
+
+    f->fn = fn;
+    f->arg = arg;
+    f->stack = (unsigned long*)((char*)f + FIBER_HDR_SIZE);
+    f->stack_size = stack_size;
+    f->done = false;
+
+    for (size_t i = 0; i < stack_size / sizeof(unsigned long); ++i)
+        f->stack[i] = FIBER_PATTERN;
+
+    // initial frame of hal_fiber_switch(): ra - the entry, s0 - the fiber
+    unsigned long *frame = (unsigned long*)((char*)f->stack + stack_size - HAL_FIBER_FRAME_SIZE);
+
+    for (unsigned i = 0; i < HAL_FIBER_FRAME_SIZE / sizeof(unsigned long); ++i)
+        frame[i] = 0;
+    frame[0] = (unsigned long)hal_fiber_start;
+    frame[1] = (unsigned long)f;
+
+    f->ctx.sp = frame;
+    f->ctx.fp_saved = 0;
+
+    fiber_hart_t *h = this_hart_local(fiber_hart);
+
+    ++h->stat.created;
+    ++h->stat.live;
+    fiber_enqueue(h, f);
+
+    return f;
+}
+
+void hal_fiber_yield(void)
+{
+    fiber_hart_t *h = this_hart_local(fiber_hart);
+    hal_fiber_t *next = fiber_dequeue(h);
+
+    if (!next)
+        return;
+
+    hal_fiber_t *self = fiber_current(h);
+
+    fiber_enqueue(h, self);
+    fiber_switch(h, self, next);
+}
+
+int hal_fiber_join(hal_fiber_t *fiber)
+{
+    while (!fiber->done)
+        hal_fiber_yield();
+
+    const int rc = fiber_guard_ok(fiber) ? 0 : -EFAULT;
+
+    if (rc)
+        hal_fiber_stack_overflow(fiber);
+
+    --this_hart_local(fiber_hart)->stat.live;
+    free(fiber);
+
+    return rc;
+}
+
+hal_fiber_t *hal_fiber_self(void)
+{
+    return this_hart_local(fiber_hart)->current;
+}
+
+int hal_fiber_check_stack(const hal_fiber_t *fiber)
+{
+    return fiber_guard_ok(fiber) ? 0 : -EFAULT;
+}
+
+size_t hal_fiber_stack_used(const hal_fiber_t *fiber)
+{
+    const size_t words = fiber->stack_size / sizeof(unsigned long);
+    size_t i = 0;
+
+    while (i < words && fiber->stack[i] == FIBER_PATTERN)
+        ++i;
+
+    return (words - i) * sizeof(unsigned long);
+}
+
+void hal_fiber_get_stat(hal_fiber_stat_t *stat)
+{
+    *stat = this_hart_local(fiber_hart)->stat;
+}
@@ -0,0 +1,330 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Per-hart heap arenas
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+
+#include "heap.h"
+
+#include "arch.h"
+#include "drivers/cache.h"
+#include "hart_local.h"
+#include "lock.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/errno.h>
+#include <unistd.h> /* sbrk() */
+
+#ifdef PLF_MAX_CACHELINE_SIZE
+#define HEAP_LINE __attribute__((aligned(PLF_MAX_CACHELINE_SIZE)))
+#else
+#define HEAP_LINE __attribute__((aligned(64)))
+#endif
+
+#define HEAP_ALIGN 16
+
+// size classes: HEAP_SMALL_STEP multiples up to HEAP_SMALL_MAX, then powers of 2
+#define HEAP_SMALL_STEP    16
+#define HEAP_SMALL_MAX     1024
+#define HEAP_SMALL_CLASSES (HEAP_SMALL_MAX / HEAP_SMALL_STEP)
+#define HEAP_LARGE_MIN     (2 * HEAP_SMALL_MAX)
+#define HEAP_LARGE_CLASSES (sizeof(size_t) * 8 - 13)
+#define HEAP_CLASSES       (HEAP_SMALL_CLASSES + HEAP_LARGE_CLASSES)
+#define HEAP_MAX_SIZE      ((size_t)HEAP_LARGE_MIN << (HEAP_LARGE_CLASSES - 1))
+
+// block info: size class | owner hart << HEAP_OWNER_SHIFT
+#define HEAP_CLASS_MASK    0xff
+#define HEAP_OWNER_SHIFT   8
+// memalign() block: next points to the allocated block
+#define HEAP_INFO_ALIGNED  (~(uintptr_t)0)
+
+typedef struct heap_hdr {
+    uintptr_t info;
+    struct heap_hdr *next; // free list link
+} __attribute__((aligned(HEAP_ALIGN))) heap_hdr_t;
+
+typedef struct {
+    // owner only
+    heap_hdr_t *free[HEAP_CLASSES];
+    char *chunk;
+    char *chunk_end;
+    // blocks freed by the other harts
+    struct {
+        arch_lock_t lock;
+        heap_hdr_t *head;
+    } HEAP_LINE remote;
+} HEAP_LINE heap_arena_t;
+
+static __hart_local heap_arena_t heap_arena;
+
+static inline void heap_sync_out(volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_flush((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static inline void heap_sync_in(volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static inline unsigned heap_class(size_t size)
+{
+    if (size <= HEAP_SMALL_MAX)
+        return size ? (unsigned)((size - 1) / HEAP_SMALL_STEP) : 0;
+
+    // HEAP_LARGE_MIN << k >= size
+    const unsigned bits = (unsigned)(sizeof(size_t) * 8) - (unsigned)__builtin_clzl((unsigned long)(size - 1));
+
+    return HEAP_SMALL_CLASSES + (bits > 11 ? bits - 11 : 0);
+}
+
+static inline size_t heap_class_size(unsigned c)
+{
+    if (c < HEAP_SMALL_CLASSES)
+        return (size_t)(c + 1) * HEAP_SMALL_STEP;
+
+    return (size_t)HEAP_LARGE_MIN << (c - HEAP_SMALL_CLASSES);
+}
+
+static heap_hdr_t *heap_block(const void *ptr)
+{
+    heap_hdr_t *h = (heap_hdr_t*)ptr - 1;
+
+    return (h->info == HEAP_INFO_ALIGNED) ? h->next : h;
+}
+
+static void *heap_sbrk(size_t size)
+{
+    // sbrk() is shared with plf_alloc_thread() and newlib: align the result
+    char *p = sbrk((ptrdiff_t)(size + HEAP_ALIGN - 1));
+
+    if (p == (void*)-ENOMEM)
+        return NULL;
+
+    return (void*)(((uintptr_t)p + HEAP_ALIGN - 1) & -(uintptr_t)HEAP_ALIGN);
+}
+
+static heap_hdr_t *heap_refill(heap_arena_t *a, unsigned c)
+{
+    const size_t bsize = sizeof(heap_hdr_t) + heap_class_size(c);
+
+    // big blocks are taken from sbrk() directly
+    if (bsize > PLF_MALLOC_ARENA_CHUNK / 8)
+        return heap_sbrk(bsize);
+
+    if ((size_t)(a->chunk_end - a->chunk) < bsize) {
+        char *p = heap_sbrk(PLF_MALLOC_ARENA_CHUNK);
+
+        if (!p)
+            return NULL;
+        a->chunk = p;
+        a->chunk_end = p + PLF_MALLOC_ARENA_CHUNK;
+    }
+
+    heap_hdr_t *h = (heap_hdr_t*)a->chunk;
+
+    a->chunk += bsize;
+
+    return h;
+}
+
+// moves the blocks freed by the other harts to the local free lists
+static void heap_drain(heap_arena_t *a)
+{
+    heap_sync_in(&a->remote.head, sizeof(a->remote.head));
+    if (!a->remote.head)
+        return;
+
+    arch_lock(&a->remote.lock);
+    heap_sync_in(&a->remote.head, sizeof(a->remote.head));
+    heap_hdr_t *h = a->remote.head;
+    a->remote.head = NULL;
+    heap_sync_out(&a->remote.head, sizeof(a->remote.head));
+    arch_unlock(&a->remote.lock);
+
+    while (h) {
+        heap_sync_in(h, sizeof(*h));
+
+        heap_hdr_t *next = h->next;
+        const unsigned c = h->info & HEAP_CLASS_MASK;
+
+        h->next = a->free[c];
+        a->free[c] = h;
+        h = next;
+    }
+}
+
+void *hal_arena_malloc(size_t size)
+{
+    if (size > HEAP_MAX_SIZE) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    heap_arena_t *a = this_hart_local(heap_arena);
+    const unsigned c = heap_class(size);
+    heap_hdr_t *h = a->free[c];
+
+    if (!h) {
+        heap_drain(a);
+        h = a->free[c];
+    }
+
+    if (h) {
+        a->free[c] = h->next;
+    } else {
+        h = heap_refill(a, c);
+        if (!h) {
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+
+    h->info = c | ((uintptr_t)hart_local_index() << HEAP_OWNER_SHIFT);
+
+    return h + 1;
+}
+
+void hal_arena_free(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    heap_hdr_t *h = heap_block(ptr);
+    const unsigned owner = (unsigned)(h->info >> HEAP_OWNER_SHIFT);
+
+    if (owner == hart_local_index()) {
+        heap_arena_t *a = this_hart_local(heap_arena);
+        const unsigned c = h->info & HEAP_CLASS_MASK;
+
+        h->next = a->free[c];
+        a->free[c] = h;
+        return;
+    }
+
+    // cross-hart free: queue the block to the owner
+    heap_arena_t *a = hart_local_ptr(heap_arena, owner);
+
+    arch_lock(&a->remote.lock);
+    heap_sync_in(&a->remote.head, sizeof(a->remote.head));
+    h->next = a->remote.head;
+    heap_sync_out(h, sizeof(*h));
+    a->remote.head = h;
+    heap_sync_out(&a->remote.head, sizeof(a->remote.head));
+    arch_unlock(&a->remote.lock);
+}
+
+size_t hal_arena_usable_size(const void *ptr)
+{
+    if (!ptr)
+        return 0;
+
+    const heap_hdr_t *h = heap_block(ptr);
+
+    return heap_class_size(h->info & HEAP_CLASS_MASK) - (size_t)((const char*)ptr - (const char*)(h + 1));
+}
+
+void *hal_arena_realloc(void *ptr, size_t size)
+{
+    if (!ptr)
+        return hal_arena_malloc(size);
+
+    if (!size) {
+        hal_arena_free(ptr);
+        return NULL;
+    }
+
+    const size_t usable = hal_arena_usable_size(ptr);
+
+    if (size <= usable)
+        return ptr;
+
+    void *p = hal_arena_malloc(size);
+
+    if (p) {
+        memcpy(p, ptr, usable);
+        hal_arena_free(ptr);
+    }
+
+    return p;
+}
+
+void *hal_arena_calloc(size_t n, size_t size)
+{
+    if (size && n > HEAP_MAX_SIZE / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    void *p = hal_arena_malloc(n * size);
+
+    if (p)
+        memset(p, 0, n * size);
+
+    return p;
+}
+
+void *hal_arena_memalign(size_t align, size_t size)
+{
+    if (align <= HEAP_ALIGN)
+        return hal_arena_malloc(size);
+
+    if (align & (align - 1)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (size > HEAP_MAX_SIZE - align) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // the aligned pointer is preceded by a header pointing to the block
+    char *raw = hal_arena_malloc(size + align);
+
+    if (!raw)
+        return NULL;
+
+    heap_hdr_t *p = (heap_hdr_t*)(((uintptr_t)raw + sizeof(heap_hdr_t) + align - 1) & -(uintptr_t)align);
+
+    p[-1].info = HEAP_INFO_ALIGNED;
+    p[-1].next = (heap_hdr_t*)raw - 1;
+
+    return p;
+}
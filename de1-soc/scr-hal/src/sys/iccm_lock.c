@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief ICCM message based lock and semaphore service
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+#include "iccm_lock.h"
+
+#if PLF_ICCM_LOCK_SUPPORT
+
+#include "arch.h"
+#include "drivers/iccm_l3.h"
+#include "drivers/ipi.h"
+#include "hart_local.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Message format:
+ *   bit 31     - lock service message (ipi_send() messages have it clear)
+ *   bits 30:28 - operation
+ *   bits 27:0  - object key, (addr >> 2)
+ */
+#define ICCM_MSG_SVC       (1UL << 31)
+#define ICCM_MSG_OP_OFFS   (28)
+#define ICCM_MSG_OP_MASK   (7UL << ICCM_MSG_OP_OFFS)
+#define ICCM_MSG_KEY_MASK  ((1UL << ICCM_MSG_OP_OFFS) - 1)
+
+enum {
+    ICCM_OP_LOCK = 0,   // requests, to the arbiter
+    ICCM_OP_TRYLOCK,
+    ICCM_OP_UNLOCK,
+    ICCM_OP_SEM_WAIT,
+    ICCM_OP_SEM_TRYWAIT,
+    ICCM_OP_SEM_POST,
+    ICCM_OP_GRANT,      // replies, to the requester
+    ICCM_OP_DENY
+};
+
+#define ICCM_MSG(op, key) ((uint32_t)(ICCM_MSG_SVC | ((unsigned long)(op) << ICCM_MSG_OP_OFFS) | (key)))
+#define ICCM_MSG_OP(msg)  (((msg) & ICCM_MSG_OP_MASK) >> ICCM_MSG_OP_OFFS)
+#define ICCM_MSG_KEY(msg) ((msg) & ICCM_MSG_KEY_MASK)
+
+#define ICCM_KEY(p)       ((uint32_t)(((uintptr_t)(p) >> 2) & ICCM_MSG_KEY_MASK))
+
+// arbiter: lock is a semaphore with the initial count 1
+typedef struct {
+    uint32_t key;           // 0 - free
+    int count;
+    int initial;
+    unsigned last;          // last granted hart, waiters are served round-robin
+    unsigned long waiters;
+} iccm_slot_t;
+
+static iccm_slot_t iccm_slots[PLF_ICCM_LOCK_SLOTS];
+
+// requester: reply to the outstanding request, written by the owner hart only
+typedef struct {
+    volatile uint32_t msg;
+} __attribute__((aligned(PLF_MAX_CACHELINE_SIZE))) iccm_reply_t;
+
+static __hart_local iccm_reply_t iccm_reply;
+
+static inline unsigned iccm_self(void)
+{
+    return (unsigned)(arch_hartid() - PLF_SMP_HARTID_BASE);
+}
+
+
+static void iccm_send(unsigned hart, uint32_t msg)
+{
+    // drain own buffer: the receiver may be waiting to send to us
+    while (iccm_l3_receiver_busy(iccm_l3_get_own_id(), (iccm_l3_id)hart))
+        (void)iccm_lock_pump();
+
+    iccm_l3_write_msg((iccm_l3_id)hart, msg);
+}
+
+static void iccm_reply_to(unsigned hart, uint32_t msg)
+{
+    if (hart == iccm_self())
+        this_hart_local(iccm_reply)->msg = msg;
+    else
+        iccm_send(hart, msg);
+}
+
+//----------------------
+// arbiter
+//----------------------
+
+static iccm_slot_t *iccm_slot(uint32_t key, int initial)
+{
+    iccm_slot_t *free_slot = NULL;
+
+    for (unsigned i = 0; i < PLF_ICCM_LOCK_SLOTS; ++i) {
+        if (iccm_slots[i].key == key)
+            return &iccm_slots[i];
+        if (!free_slot && !iccm_slots[i].key)
+            free_slot = &iccm_slots[i];
+    }
+
+    if (!free_slot)
+        abort(); // PLF_ICCM_LOCK_SLOTS exhausted
+
+    free_slot->key = key;
+    free_slot->count = initial;
+    free_slot->initial = initial;
+    free_slot->last = 0;
+    free_slot->waiters = 0;
+
+    return free_slot;
+}
+
+static void iccm_slot_put(iccm_slot_t *s)
+{
+    // back to the initial state: the slot can be reused
+    if (s->count == s->initial && !s->waiters)
+        s->key = 0;
+}
+
+static void iccm_acquire(unsigned hart, uint32_t key, int initial, bool try_only)
+{
+    iccm_slot_t *s = iccm_slot(key, initial);
+
+    if (s->count > 0) {
+        s->count--;
+        s->last = hart;
+        iccm_reply_to(hart, ICCM_MSG(ICCM_OP_GRANT, key));
+    } else if (try_only) {
+        iccm_slot_put(s);
+        iccm_reply_to(hart, ICCM_MSG(ICCM_OP_DENY, key));
+    } else {
+        s->waiters |= 1UL << hart;
+    }
+}
+
+static void iccm_release(uint32_t key, int initial)
+{
+    iccm_slot_t *s = iccm_slot(key, initial);
+
+    if (s->waiters) {
+        // pass the ownership to the next waiter after the last owner
+        for (unsigned i = 1; i <= PLF_SMP_HART_NUM; ++i) {
+            const unsigned h = (s->last + i) % PLF_SMP_HART_NUM;
+
+            if (s->waiters & (1UL << h)) {
+                s->waiters &= ~(1UL << h);
+                s->last = h;
+                iccm_reply_to(h, ICCM_MSG(ICCM_OP_GRANT, key));
+                break;
+            }
+        }
+    } else {
+        s->count++;
+    }
+
+    iccm_slot_put(s);
+}
+
+static void iccm_arbitrate(unsigned hart, uint32_t msg)
+{
+    const uint32_t key = ICCM_MSG_KEY(msg);
+
+    switch (ICCM_MSG_OP(msg)) {
+    case ICCM_OP_LOCK:
+        iccm_acquire(hart, key, 1, false);
+        break;
+    case ICCM_OP_TRYLOCK:
+        iccm_acquire(hart, key, 1, true);
+        break;
+    case ICCM_OP_UNLOCK:
+        iccm_release(key, 1);
+        break;
+    case ICCM_OP_SEM_WAIT:
+        iccm_acquire(hart, key, 0, false);
+        break;
+    case ICCM_OP_SEM_TRYWAIT:
+        iccm_acquire(hart, key, 0, true);
+        break;
+    case ICCM_OP_SEM_POST:
+        iccm_release(key, 0);
+        break;
+    default:
+        break;
+    }
+}
+
+//----------------------
+// message dispatch
+//----------------------
+
+unsigned iccm_lock_pump(void)
+{
+    unsigned n = 0;
+
+    while (ipi_l3_msg_available()) {
+        const unsigned sender = iccm_l3_get_sender_id();
+        const uint32_t msg = iccm_l3_read_msg();
+
+        ++n;
+
+        // plain IPI messages are only a wakeup, see ipi_trap_handler()
+        if (!(msg & ICCM_MSG_SVC))
+            continue;
+
+        if (ICCM_MSG_OP(msg) >= ICCM_OP_GRANT)
+            this_hart_local(iccm_reply)->msg = msg;
+        else
+            iccm_arbitrate(sender, msg);
+    }
+
+    return n;
+}
+
+/*
+ * ipi_send() does not queue a message while the receiver holds an unread one
+ * from the same sender, so any consumed message may stand for a skipped IPI:
+ * check for a cross-hart request after consuming messages outside of the trap.
+ */
+static void iccm_ipi_check(unsigned msgs)
+{
+    if (msgs)
+        (void)ipi_trap_handler(TRAP_CAUSE_INTERRUPT_FLAG | TRAP_CAUSE_INT_MSOFT);
+}
+
+void arch_iccm_service(void)
+{
+    const unsigned long mstatus = clear_csr(mstatus, MSTATUS_MIE);
+    const unsigned msgs = iccm_lock_pump();
+
+    set_csr(mstatus, mstatus & MSTATUS_MIE);
+
+    iccm_ipi_check(msgs);
+}
+
+// send the request and wait for the reply, returns true if granted
+static bool iccm_request(unsigned op, const void *obj)
+{
+    const uint32_t key = ICCM_KEY(obj);
+    const unsigned self = iccm_self();
+    iccm_reply_t *reply = this_hart_local(iccm_reply);
+    unsigned msgs = 0;
+
+    // key 0 marks a free arbiter slot: the object is at a 1 GiB boundary
+    if (!key)
+        abort();
+
+    // the reply is consumed here, not by the ICCM interrupt handler
+    const unsigned long mstatus = clear_csr(mstatus, MSTATUS_MIE);
+
+    reply->msg = 0;
+
+    if (self == PLF_ICCM_LOCK_ARBITER)
+        iccm_arbitrate(self, ICCM_MSG(op, key));
+    else
+        iccm_send(PLF_ICCM_LOCK_ARBITER, ICCM_MSG(op, key));
+
+    if (op != ICCM_OP_UNLOCK && op != ICCM_OP_SEM_POST) {
+        while (1) {
+            msgs += iccm_lock_pump();
+            if (reply->msg)
+                break;
+            // woken up by the pending ICCM interrupt
+            if (read_csr(mie) & MIE_MSOFTWARE)
+                wfi();
+        }
+    }
+
+    // acquire barrier
+    __asm__ __volatile__ ("fence r , rw\n" ::: "memory");
+
+    set_csr(mstatus, mstatus & MSTATUS_MIE);
+
+    iccm_ipi_check(msgs);
+
+    return ICCM_MSG_OP(reply->msg) == ICCM_OP_GRANT;
+}
+
+static void iccm_post(unsigned op, const void *obj)
+{
+    // release barrier
+    __asm__ __volatile__ ("fence rw , w\n" ::: "memory");
+
+    (void)iccm_request(op, obj);
+}
+
+void arch_iccm_lock(arch_iccm_lock_t *lock)
+{
+    (void)iccm_request(ICCM_OP_LOCK, lock);
+}
+
+int arch_iccm_trylock(arch_iccm_lock_t *lock)
+{
+    return iccm_request(ICCM_OP_TRYLOCK, lock);
+}
+
+void arch_iccm_unlock(arch_iccm_lock_t *lock)
+{
+    iccm_post(ICCM_OP_UNLOCK, lock);
+}
+
+void arch_iccm_sem_init(arch_iccm_sem_t *sem, unsigned count)
+{
+    while (count--)
+        iccm_post(ICCM_OP_SEM_POST, sem);
+}
+
+void arch_iccm_sem_wait(arch_iccm_sem_t *sem)
+{
+    (void)iccm_request(ICCM_OP_SEM_WAIT, sem);
+}
+
+int arch_iccm_sem_trywait(arch_iccm_sem_t *sem)
+{
+    return iccm_request(ICCM_OP_SEM_TRYWAIT, sem);
+}
+
+void arch_iccm_sem_post(arch_iccm_sem_t *sem)
+{
+    iccm_post(ICCM_OP_SEM_POST, sem);
+}
+
+#endif // PLF_ICCM_LOCK_SUPPORT
@@ -54,12 +54,58 @@
 #if PLF_SMP_SUPPORT && !PLF_ATOMIC_SUPPORTED
 
 #include "lock.h"
+#include "iccm_lock.h"
 #include "drivers/cache.h" /* flush/invalidate */
 
 #if PLF_SMP_HART8_XLEN < PLF_SMP_HART_NUM
 #error multiword lock is not implemented yet
 #endif
 
+#if PLF_ICCM_ARCH_LOCK && PLF_ICCM_LOCK_SUPPORT
+
+// ICCM lock service: no memory traffic, see iccm_lock.h
+// flags[0] is only an owner hint for arch_is_locked()
+static void iccm_set_owned(arch_lock_t *lock, unsigned long val)
+{
+    lock->flags[0] = val;
+#if PLF_SMP_NON_COHERENT
+    cache_l1_flush((void*)&(lock->flags[0]), sizeof(lock->flags[0]));
+#endif // PLF_SMP_NON_COHERENT
+}
+
+void arch_lock(arch_lock_t *lock)
+{
+    arch_iccm_lock((arch_iccm_lock_t*)lock);
+    iccm_set_owned(lock, 1);
+}
+
+int arch_trylock(arch_lock_t *lock)
+{
+    if (!arch_iccm_trylock((arch_iccm_lock_t*)lock))
+        return 0;
+    iccm_set_owned(lock, 1);
+
+    return 1;
+}
+
+void arch_unlock(arch_lock_t *lock)
+{
+    iccm_set_owned(lock, 0);
+    arch_iccm_unlock((arch_iccm_lock_t*)lock);
+}
+
+int arch_is_locked(arch_lock_t *lock)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)&(lock->flags[0]), sizeof(lock->flags[0]));
+#else
+    fence();
+#endif // PLF_SMP_NON_COHERENT
+    return lock->flags[0] != 0;
+}
+
+#else // PLF_ICCM_ARCH_LOCK && PLF_ICCM_LOCK_SUPPORT
+
 static unsigned long asp_read_flags(arch_lock_t *lock)
 {
 #if PLF_SMP_NON_COHERENT
@@ -114,12 +160,12 @@ enum ASP_state {
 
 static void asp_wait_all_in(arch_lock_t *lock, unsigned long mask)
 {
-    while ((asp_read_flags(lock) & ~mask) != 0);
+    arch_spin_until(&arch_spin_site_lock, (asp_read_flags(lock) & ~mask) == 0);
 }
 
 static void asp_wait_any_eq(arch_lock_t *lock, unsigned long mask)
 {
-    while ((asp_read_flags(lock) & mask) == 0);
+    arch_spin_until(&arch_spin_site_lock, (asp_read_flags(lock) & mask) != 0);
 }
 
 void arch_lock(arch_lock_t *lock)
@@ -166,4 +212,189 @@ void arch_unlock(arch_lock_t *lock)
     asp_write_flag(lock, self_pos, ASP_ST0);
 }
 
+int arch_trylock(arch_lock_t *lock)
+{
+    long self_pos = (long)arch_hartid();
+    unsigned long self_mask = 0xffUL << (self_pos << 3);
+
+    if (asp_read_flag(lock, self_pos) == ASP_ST4)
+        return 1; // recursive call, as arch_lock()
+
+    // another hart holds the lock or is in the entry/exit protocol
+    if (asp_read_flags(lock) & ~self_mask & ~MK_ASP_MASK(ASP_ST0))
+        return 0;
+
+    // at most a hart entering at the same moment is waited for
+    arch_lock(lock);
+
+    return 1;
+}
+
+int arch_is_locked(arch_lock_t *lock)
+{
+    return (asp_read_flags(lock) & ~MK_ASP_MASK(ASP_ST0)) != 0;
+}
+
+#endif // PLF_ICCM_ARCH_LOCK && PLF_ICCM_LOCK_SUPPORT
+
 #endif // PLF_SMP_SUPPORT && !PLF_ATOMIC_SUPPORTED
+
+#if PLF_SMP_SUPPORT && PLF_ATOMIC_SUPPORTED
+
+#include "lock.h"
+#include "hart_local.h"
+#include "drivers/cache.h" /* flush/invalidate */
+
+#include <stdlib.h> /* abort() */
+
+#if __riscv_xlen == 32
+#define MCS_AMO_SFX "w"
+#else
+#define MCS_AMO_SFX "d"
+#endif
+
+// per-hart pool of queue nodes
+static __hart_local arch_mcs_node_t mcs_nodes[PLF_MCS_LOCK_NODES];
+
+static inline void mcs_sync_out(volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_flush((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static inline void mcs_sync_in(volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static arch_mcs_node_t *mcs_node_get(void)
+{
+    arch_mcs_node_t *nodes = *this_hart_local(mcs_nodes);
+
+    for (int i = 0; i < PLF_MCS_LOCK_NODES; ++i) {
+        if (!nodes[i].busy) {
+            nodes[i].busy = 1;
+            return &nodes[i];
+        }
+    }
+
+    // too many MCS locks held by the hart
+    abort();
+}
+
+static inline arch_mcs_node_t *mcs_xchg_tail(arch_mcs_lock_t *lock, arch_mcs_node_t *node)
+{
+    arch_mcs_node_t *prev;
+
+    __asm__ __volatile__ (
+        "amoswap." MCS_AMO_SFX ".aqrl %0, %2, %1"
+        : "=r" (prev), "+A" (lock->tail)
+        : "r" (node)
+        : "memory");
+
+    return prev;
+}
+
+static inline int mcs_cas_tail(arch_mcs_lock_t *lock, arch_mcs_node_t *cmp, arch_mcs_node_t *node)
+{
+    arch_mcs_node_t *ret;
+    unsigned int rc;
+
+    __asm__ __volatile__ (
+        "0: lr." MCS_AMO_SFX ".aq %0, %2\n"
+        "bne  %0, %3, 1f\n"
+        "sc." MCS_AMO_SFX ".rl %1, %4, %2\n"
+        "bnez %1, 0b\n"
+        "1:\n"
+        : "=&r" (ret), "=&r" (rc), "+A" (lock->tail)
+        : "r" (cmp), "r" (node)
+        : "memory");
+
+    return ret == cmp;
+}
+
+int arch_mcs_trylock(arch_mcs_lock_t *lock)
+{
+    arch_mcs_node_t *node = mcs_node_get();
+
+    node->next = NULL;
+    node->locked = 0;
+    mcs_sync_out(node, sizeof(*node));
+
+    if (!mcs_cas_tail(lock, NULL, node)) {
+        node->busy = 0;
+        return 0;
+    }
+
+    lock->owner = node;
+
+    return 1;
+}
+
+void arch_mcs_lock(arch_mcs_lock_t *lock)
+{
+    arch_mcs_node_t *node = mcs_node_get();
+
+    node->next = NULL;
+    node->locked = 1;
+    mcs_sync_out(node, sizeof(*node));
+
+    arch_mcs_node_t *prev = mcs_xchg_tail(lock, node);
+
+    if (prev) {
+        // link to the queue and spin on the own node
+        prev->next = node;
+        mcs_sync_out(&prev->next, sizeof(prev->next));
+        arch_spin_wake(&arch_spin_site_mcs);
+
+        arch_spin_until(&arch_spin_site_mcs,
+                        (mcs_sync_in(&node->locked, sizeof(node->locked)), !node->locked));
+
+        // acquire barrier
+        __asm__ __volatile__ ("fence r , rw\n" ::: "memory");
+    }
+
+    lock->owner = node;
+}
+
+void arch_mcs_unlock(arch_mcs_lock_t *lock)
+{
+    arch_mcs_node_t *node = lock->owner;
+
+    // release barrier
+    __asm__ __volatile__ ("fence rw , w\n" ::: "memory");
+
+    mcs_sync_in(&node->next, sizeof(node->next));
+
+    if (!node->next) {
+        // no waiters: release the lock
+        if (mcs_cas_tail(lock, node, NULL)) {
+            node->busy = 0;
+            return;
+        }
+
+        // a new waiter is linking itself
+        arch_spin_until(&arch_spin_site_mcs,
+                        (mcs_sync_in(&node->next, sizeof(node->next)), node->next != NULL));
+    }
+
+    // hand over to the successor
+    arch_mcs_node_t *next = node->next;
+
+    next->locked = 0;
+    mcs_sync_out(&next->locked, sizeof(next->locked));
+    arch_spin_wake(&arch_spin_site_mcs);
+
+    node->busy = 0;
+}
+
+#endif // PLF_SMP_SUPPORT && PLF_ATOMIC_SUPPORTED
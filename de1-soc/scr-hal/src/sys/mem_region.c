@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Memory regions: region heaps
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+#include "mem_region.h"
+
+#include "lock.h"
+
+#include <malloc.h> /* memalign() */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/errno.h>
+
+// region heaps, see bsp0.lds
+extern char __ocram_heap_start[], __ocram_heap_size[];
+extern char __tcm_heap_start[], __tcm_heap_size[];
+extern char __ddr_heap_start[], __ddr_heap_size[];
+
+static struct {
+    hal_tlsf_heap_t *heap[HAL_MEM_REGIONS];
+    bool init[HAL_MEM_REGIONS];
+    arch_lock_t lock;
+} mem_regions;
+
+static hal_tlsf_heap_t *mem_region_create(hal_mem_region_t region)
+{
+    switch (region) {
+    case HAL_MEM_OCRAM:
+        return hal_tlsf_create(__ocram_heap_start, (size_t)__ocram_heap_size);
+    case HAL_MEM_TCM:
+        return hal_tlsf_create(__tcm_heap_start, (size_t)__tcm_heap_size);
+    case HAL_MEM_DDR:
+        return hal_tlsf_create(__ddr_heap_start, (size_t)__ddr_heap_size);
+    default:
+        return NULL;
+    }
+}
+
+// NULL: the region is served by malloc()
+static hal_tlsf_heap_t *mem_region_heap(hal_mem_region_t region)
+{
+    if ((unsigned)region >= HAL_MEM_REGIONS)
+        return NULL;
+
+    if (*(volatile bool*)&mem_regions.init[region]) {
+        fence();
+    } else {
+        arch_lock(&mem_regions.lock);
+        if (!mem_regions.init[region]) {
+            mem_regions.heap[region] = mem_region_create(region);
+            fence();
+            *(volatile bool*)&mem_regions.init[region] = true;
+        }
+        arch_unlock(&mem_regions.lock);
+    }
+
+    return mem_regions.heap[region];
+}
+
+void *hal_memalign_in(hal_mem_region_t region, size_t align, size_t size)
+{
+    hal_tlsf_heap_t *heap = mem_region_heap(region);
+
+    return heap ? hal_tlsf_heap_memalign(heap, align, size) : memalign(align, size);
+}
+
+void *hal_malloc_in(hal_mem_region_t region, size_t size)
+{
+    hal_tlsf_heap_t *heap = mem_region_heap(region);
+
+    return heap ? hal_tlsf_heap_memalign(heap, 0, size) : malloc(size);
+}
+
+void *hal_calloc_in(hal_mem_region_t region, size_t n, size_t size)
+{
+    if (size && n > (size_t)-1 / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    void *p = hal_malloc_in(region, n * size);
+
+    if (p)
+        memset(p, 0, n * size);
+
+    return p;
+}
+
+void hal_free_in(hal_mem_region_t region, void *ptr)
+{
+    hal_tlsf_heap_t *heap = mem_region_heap(region);
+
+    if (heap)
+        hal_tlsf_heap_free(heap, ptr);
+    else
+        free(ptr);
+}
+
+int hal_mem_region_get_stat(hal_mem_region_t region, hal_tlsf_stat_t *stat)
+{
+    hal_tlsf_heap_t *heap = mem_region_heap(region);
+
+    if (!heap)
+        return -ENODEV;
+
+    hal_tlsf_heap_get_stat(heap, stat);
+
+    return 0;
+}
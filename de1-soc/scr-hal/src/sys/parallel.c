@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Parallel loops over all harts
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+
+#include "parallel.h"
+
+#include "arch.h"
+#include "atomic.h"
+#include "drivers/cache.h"
+#include "hart_local.h"
+#include "task.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/errno.h>
+
+#ifdef PLF_SMP_SUPPORT
+#define PARALLEL_HARTS PLF_SMP_HART_NUM
+#else
+#define PARALLEL_HARTS 1
+#endif // PLF_SMP_SUPPORT
+
+#if PARALLEL_HARTS > PLF_PARALLEL_MAX_CHUNKS
+#error PLF_PARALLEL_MAX_CHUNKS must not be less than the number of harts
+#endif
+
+#ifdef PLF_MAX_CACHELINE_SIZE
+#define PARALLEL_ALIGN __attribute__((aligned(PLF_MAX_CACHELINE_SIZE)))
+#else
+#define PARALLEL_ALIGN __attribute__((aligned(64)))
+#endif
+
+// written by the calling hart before the team is started
+static struct {
+    hal_parallel_sched_t sched;
+    long begin;
+    long end;
+    long grain;
+    unsigned nchunks;
+    hal_for_fn_t fn;
+    hal_reduce_fn_t reduce;
+    void *ctx;
+    unsigned size;
+    char identity[PLF_PARALLEL_REDUCE_SIZE];
+    long start[PLF_PARALLEL_MAX_CHUNKS + 1]; // guided chunk bounds
+} PARALLEL_ALIGN parallel_job;
+
+// next chunk of the dynamic schedules
+static struct {
+    arch_atomic_t next;
+} PARALLEL_ALIGN parallel_next;
+
+static struct {
+    char val[PLF_PARALLEL_REDUCE_SIZE];
+} PARALLEL_ALIGN parallel_partial[PLF_PARALLEL_MAX_CHUNKS];
+
+static __hart_local struct {
+    hal_parallel_stat_t s;
+} PARALLEL_ALIGN parallel_stat;
+
+static inline void parallel_sync_out(volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_flush((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static inline void parallel_sync_in(volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static void parallel_chunk(unsigned k, long *begin, long *end)
+{
+    const long b = parallel_job.begin;
+    const long e = parallel_job.end;
+
+    switch (parallel_job.sched) {
+    case HAL_PARALLEL_STATIC:
+        *begin = b + (long)((int64_t)(e - b) * k / PARALLEL_HARTS);
+        *end = b + (long)((int64_t)(e - b) * (k + 1) / PARALLEL_HARTS);
+        break;
+    case HAL_PARALLEL_CHUNKED:
+        *begin = b + (long)k * parallel_job.grain;
+        *end = (e - *begin > parallel_job.grain) ? *begin + parallel_job.grain : e;
+        break;
+    default:
+        *begin = parallel_job.start[k];
+        *end = parallel_job.start[k + 1];
+        break;
+    }
+}
+
+static void parallel_run_chunk(unsigned k, hal_parallel_stat_t *stat)
+{
+    long b, e;
+
+    parallel_chunk(k, &b, &e);
+    if (b >= e)
+        return;
+
+    const uint64_t t0 = arch_cycle();
+
+    if (parallel_job.reduce) {
+        void *acc = parallel_partial[k].val;
+
+        memcpy(acc, parallel_job.identity, parallel_job.size);
+        parallel_job.reduce(b, e, acc, parallel_job.ctx);
+        parallel_sync_out(acc, parallel_job.size);
+    } else {
+        parallel_job.fn(b, e, parallel_job.ctx);
+    }
+
+    stat->body_cycles += arch_cycle() - t0;
+    ++stat->chunks;
+}
+
+static void parallel_member(void *arg)
+{
+    const unsigned slot = (unsigned)(uintptr_t)arg;
+    hal_parallel_stat_t *stat = &this_hart_local(parallel_stat)->s;
+    const uint64_t t0 = arch_cycle();
+
+    parallel_sync_in(&parallel_job, sizeof(parallel_job));
+
+    if (parallel_job.sched == HAL_PARALLEL_STATIC) {
+        parallel_run_chunk(slot, stat);
+    } else {
+        unsigned k;
+
+        while ((k = (unsigned)atomic_add(1, &parallel_next.next)) < parallel_job.nchunks)
+            parallel_run_chunk(k, stat);
+    }
+
+    stat->cycles += arch_cycle() - t0;
+    parallel_sync_out(stat, sizeof(*stat));
+}
+
+static void parallel_run(hal_parallel_sched_t sched, long begin, long end, long grain)
+{
+    hal_parallel_stat_t *stat = &this_hart_local(parallel_stat)->s;
+    const uint64_t t0 = arch_cycle();
+    const long n = end - begin;
+    // reduce partials and guided bounds are limited to PLF_PARALLEL_MAX_CHUNKS
+    const long min_chunk = (n + PLF_PARALLEL_MAX_CHUNKS - 1) / PLF_PARALLEL_MAX_CHUNKS;
+
+    if (grain < 1)
+        grain = 1;
+    if ((parallel_job.reduce || sched == HAL_PARALLEL_GUIDED) && grain < min_chunk)
+        grain = min_chunk;
+
+    parallel_job.sched = sched;
+    parallel_job.begin = begin;
+    parallel_job.end = end;
+    parallel_job.grain = grain;
+
+    switch (sched) {
+    case HAL_PARALLEL_STATIC:
+        parallel_job.nchunks = PARALLEL_HARTS;
+        break;
+    case HAL_PARALLEL_CHUNKED:
+        parallel_job.nchunks = (unsigned)((n + grain - 1) / grain);
+        break;
+    default: {
+        unsigned k = 0;
+
+        // every chunk but the last one is >= min_chunk: at most PLF_PARALLEL_MAX_CHUNKS chunks
+        for (long pos = 0; pos < n; ++k) {
+            long c = (n - pos) / (2 * PARALLEL_HARTS);
+
+            if (c < grain)
+                c = grain;
+            if (c > n - pos)
+                c = n - pos;
+            parallel_job.start[k] = begin + pos;
+            pos += c;
+        }
+        parallel_job.start[k] = end;
+        parallel_job.nchunks = k;
+        break;
+    }
+    }
+
+    atomic_set(&parallel_next.next, 0);
+    parallel_sync_out(&parallel_job, sizeof(parallel_job));
+
+    hal_task_group_t g = HAL_TASK_GROUP_INIT;
+
+    for (unsigned slot = 1; slot < PARALLEL_HARTS; ++slot)
+        hal_task_spawn(&g, parallel_member, (void*)(uintptr_t)slot);
+
+    parallel_member((void*)0);
+    hal_task_sync(&g);
+
+    ++stat->loops;
+    stat->loop_cycles += arch_cycle() - t0;
+    parallel_sync_out(stat, sizeof(*stat));
+}
+
+void hal_parallel_for_sched(hal_parallel_sched_t sched, long begin, long end, long grain,
+                            hal_for_fn_t fn, void *ctx)
+{
+    if (begin >= end)
+        return;
+
+    parallel_job.fn = fn;
+    parallel_job.reduce = NULL;
+    parallel_job.ctx = ctx;
+
+    parallel_run(sched, begin, end, grain);
+}
+
+int hal_parallel_reduce_sched(hal_parallel_sched_t sched, long begin, long end, long grain,
+                              hal_reduce_fn_t fn, hal_combine_fn_t combine,
+                              void *result, unsigned size, void *ctx)
+{
+    if (size > PLF_PARALLEL_REDUCE_SIZE)
+        return -EINVAL;
+
+    if (begin >= end)
+        return 0;
+
+    parallel_job.fn = NULL;
+    parallel_job.reduce = fn;
+    parallel_job.ctx = ctx;
+    parallel_job.size = size;
+    memcpy(parallel_job.identity, result, size);
+
+    parallel_run(sched, begin, end, grain);
+
+    // combine in the chunk order
+    for (unsigned k = 0; k < parallel_job.nchunks; ++k) {
+        long b, e;
+
+        parallel_chunk(k, &b, &e);
+        if (b >= e)
+            continue;
+
+        parallel_sync_in(parallel_partial[k].val, size);
+        combine(result, parallel_partial[k].val, ctx);
+    }
+
+    return 0;
+}
+
+void hal_parallel_get_stat(unsigned hart, hal_parallel_stat_t *stat)
+{
+    const hal_parallel_stat_t *s = &hart_local_ptr(parallel_stat, hart)->s;
+
+    parallel_sync_in((void*)s, sizeof(*s));
+    *stat = *s;
+}
+
+void hal_parallel_reset_stat(void)
+{
+    for (unsigned h = 0; h < PARALLEL_HARTS; ++h) {
+        hal_parallel_stat_t *s = &hart_local_ptr(parallel_stat, h)->s;
+
+        memset(s, 0, sizeof(*s));
+        parallel_sync_out(s, sizeof(*s));
+    }
+}
@@ -0,0 +1,551 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Preemptive fixed-priority scheduler
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#include "sched.h"
+
+#include "arch.h"
+#include "csr.h"
+#include "hart_local.h"
+#include "memasm.h" /* TRAP_REGS_SPACE */
+
+#include <malloc.h> /* memalign() */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/errno.h>
+
+#define SCHED_ALIGN      16
+#define SCHED_HDR_SIZE   ((sizeof(hal_thread_t) + SCHED_ALIGN - 1) & ~(size_t)(SCHED_ALIGN - 1))
+#define SCHED_FRAME_REGS (TRAP_REGS_SPACE / sizeof(unsigned long))
+#define SCHED_IDLE_PRIO  PLF_SCHED_PRIORITIES
+
+// thread calls: ecall with a0 = SCHED_ECALL_MAGIC | op, args in a1, a2
+#define SCHED_ECALL_MAGIC 0x5c4ed00UL
+#define SCHED_OP_MASK     0xffUL
+#define SCHED_OP_YIELD    1
+#define SCHED_OP_SLEEP    2
+#define SCHED_OP_JOIN     3
+#define SCHED_OP_EXIT     4
+#define SCHED_OP_RESCHED  5
+
+// trap frame slots, see context_save
+#define FRAME_PC 0
+#define FRAME_SP 2
+#define FRAME_GP 3
+#define FRAME_TP 4
+#define FRAME_A0 10
+#define FRAME_A1 11
+#define FRAME_A2 12
+
+#define MSTATUS_FS_CLEAN (2UL << 13)
+
+enum { THREAD_READY, THREAD_BLOCKED, THREAD_DONE };
+
+struct hal_thread {
+    unsigned long *frame;   // saved trap frame
+    unsigned long mstatus;
+    hal_thread_t *next;     // run or sleep queue link
+    hal_thread_t *joiner;   // the only joiner, of the same hart
+    sys_tick_t wake;
+    hal_thread_fn_t fn;
+    void *arg;
+    unsigned char prio;
+    volatile unsigned char state;
+    unsigned char fp_saved;
+    unsigned short hart;    // owner: hart_local_index() of the creator
+#if PLF_TRAP_STACK
+    // the trap frame is built on the trap stack, keep a copy
+    unsigned long ctx[SCHED_FRAME_REGS];
+#endif // PLF_TRAP_STACK
+#if __riscv_flen
+    uint64_t fp[33];        // f0-f31, fcsr: hal_sched_fp_save()
+#endif // __riscv_flen
+};
+
+// owner hart only, changed with interrupts disabled
+typedef struct {
+    hal_thread_t *current;  // NULL: not started
+    hal_thread_t *head[PLF_SCHED_PRIORITIES];
+    hal_thread_t *tail[PLF_SCHED_PRIORITIES];
+    unsigned long ready;    // bit per non-empty run queue
+    hal_thread_t *sleeping; // by wake time
+    hal_thread_t main;
+    hal_thread_t *idle;
+    sys_tick_t slice_end;
+    sys_tick_t cmp;         // programmed mtimecmp
+    hal_sched_stat_t stat;
+} sched_hart_t;
+
+static __hart_local sched_hart_t sched_hart;
+
+void trap_handler(unsigned long mcause, unsigned long mepc, unsigned long *frame);
+unsigned long *hal_sched_trap(unsigned long mcause, unsigned long mepc,
+                              unsigned long *frame, unsigned long mstatus);
+#if __riscv_flen
+void hal_sched_fp_save(void *ctx);
+void hal_sched_fp_restore(const void *ctx);
+#endif // __riscv_flen
+
+static inline unsigned long sched_ecall(unsigned long op, unsigned long arg1, unsigned long arg2)
+{
+    register unsigned long a0 __asm__("a0") = SCHED_ECALL_MAGIC | op;
+    register unsigned long a1 __asm__("a1") = arg1;
+    register unsigned long a2 __asm__("a2") = arg2;
+
+    __asm__ __volatile__ ("ecall" : "+r"(a0) : "r"(a1), "r"(a2) : "memory");
+
+    return a0;
+}
+
+static inline void sched_enqueue(sched_hart_t *h, hal_thread_t *t, bool head)
+{
+    const unsigned p = t->prio;
+
+    t->state = THREAD_READY;
+    if (!h->head[p]) {
+        t->next = NULL;
+        h->head[p] = h->tail[p] = t;
+    } else if (head) {
+        t->next = h->head[p];
+        h->head[p] = t;
+    } else {
+        t->next = NULL;
+        h->tail[p]->next = t;
+        h->tail[p] = t;
+    }
+    h->ready |= 1UL << p;
+}
+
+// highest priority ready thread or idle
+static inline hal_thread_t *sched_dequeue(sched_hart_t *h)
+{
+    if (!h->ready)
+        return h->idle;
+
+    const unsigned p = (unsigned)__builtin_ctzl(h->ready);
+    hal_thread_t *t = h->head[p];
+
+    h->head[p] = t->next;
+    if (!h->head[p]) {
+        h->tail[p] = NULL;
+        h->ready &= ~(1UL << p);
+    }
+
+    return t;
+}
+
+// a ready thread has higher priority than the current one
+static inline bool sched_preempts(const sched_hart_t *h, const hal_thread_t *cur)
+{
+    return h->ready && (unsigned)__builtin_ctzl(h->ready) < cur->prio;
+}
+
+static void sched_sleep(sched_hart_t *h, hal_thread_t *t)
+{
+    hal_thread_t **p = &h->sleeping;
+
+    while (*p && (*p)->wake <= t->wake)
+        p = &(*p)->next;
+    t->next = *p;
+    t->state = THREAD_BLOCKED;
+    *p = t;
+}
+
+static void sched_wakeup(sched_hart_t *h, sys_tick_t now)
+{
+    while (h->sleeping && h->sleeping->wake <= now) {
+        hal_thread_t *t = h->sleeping;
+
+        h->sleeping = t->next;
+        sched_enqueue(h, t, false);
+    }
+}
+
+static void sched_set_timer(sched_hart_t *h)
+{
+    sys_tick_t cmp = (h->current == h->idle) ? ~(sys_tick_t)0 : h->slice_end;
+
+    if (h->sleeping && h->sleeping->wake < cmp)
+        cmp = h->sleeping->wake;
+    // rewritten every time: clears the pending interrupt
+    h->cmp = cmp;
+    rtc_setcmp_hart(hart_local_index(), cmp);
+}
+
+// switch from the current thread to the first ready one, returns the frame to restore
+static unsigned long *sched_switch(sched_hart_t *h, unsigned long *frame,
+                                   unsigned long *mstatus, sys_tick_t now)
+{
+    hal_thread_t *cur = h->current;
+    hal_thread_t *next = sched_dequeue(h);
+
+    if (next == cur)
+        return frame;
+
+    if (cur->state != THREAD_DONE) {
+#if __riscv_flen
+        if ((*mstatus & MSTATUS_FS) == MSTATUS_FS) {
+            hal_sched_fp_save(cur->fp);
+            cur->fp_saved = 1;
+            *mstatus = (*mstatus & ~MSTATUS_FS) | MSTATUS_FS_CLEAN;
+        }
+#endif // __riscv_flen
+        cur->mstatus = *mstatus;
+#if PLF_TRAP_STACK
+        memcpy(cur->ctx, frame, TRAP_REGS_SPACE);
+#else // PLF_TRAP_STACK
+        cur->frame = frame;
+#endif // PLF_TRAP_STACK
+    }
+
+#if __riscv_flen
+    if (next->fp_saved) {
+        set_csr(mstatus, MSTATUS_FS);
+        hal_sched_fp_restore(next->fp);
+    }
+#endif // __riscv_flen
+    *mstatus = next->mstatus;
+    if (*mstatus & MSTATUS_FS)
+        *mstatus = (*mstatus & ~MSTATUS_FS) | MSTATUS_FS_CLEAN;
+#if PLF_TRAP_STACK
+    memcpy(frame, next->ctx, TRAP_REGS_SPACE);
+#else // PLF_TRAP_STACK
+    frame = next->frame;
+#endif // PLF_TRAP_STACK
+
+    h->current = next;
+    h->slice_end = now + PLF_US2TICKS(PLF_SCHED_SLICE_US);
+    ++h->stat.switches;
+
+    return frame;
+}
+
+// returns true if the current thread is preempted
+static bool sched_tick(sched_hart_t *h, sys_tick_t now)
+{
+    hal_thread_t *cur = h->current;
+
+    ++h->stat.ticks;
+    if (now >= h->cmp) {
+        const sys_tick_t late = now - h->cmp;
+
+        if (late < h->stat.jitter_min)
+            h->stat.jitter_min = late;
+        if (late > h->stat.jitter_max)
+            h->stat.jitter_max = late;
+    }
+
+    sched_wakeup(h, now);
+
+    if (cur == h->idle)
+        return h->ready != 0;
+    if (sched_preempts(h, cur)) {
+        sched_enqueue(h, cur, true);
+        return true;
+    }
+    if (now >= h->slice_end) {
+        if (h->ready & (1UL << cur->prio)) {
+            sched_enqueue(h, cur, false);
+            return true;
+        }
+        h->slice_end = now + PLF_US2TICKS(PLF_SCHED_SLICE_US);
+    }
+
+    return false;
+}
+
+// returns the ecall result: 0 or -errno
+static unsigned long sched_call(sched_hart_t *h, unsigned long *frame, sys_tick_t now)
+{
+    hal_thread_t *cur = h->current;
+    unsigned long ret = 0;
+
+    switch (frame[FRAME_A0] & SCHED_OP_MASK) {
+    case SCHED_OP_YIELD:
+        sched_enqueue(h, cur, false);
+        break;
+    case SCHED_OP_SLEEP:
+#if __riscv_xlen == 32
+        cur->wake = ((sys_tick_t)frame[FRAME_A2] << 32) | frame[FRAME_A1];
+#else // __riscv_xlen == 32
+        cur->wake = frame[FRAME_A1];
+#endif // __riscv_xlen == 32
+        if (cur->wake > now)
+            sched_sleep(h, cur);
+        else
+            sched_enqueue(h, cur, false);
+        break;
+    case SCHED_OP_JOIN: {
+        hal_thread_t *t = (hal_thread_t*)frame[FRAME_A1];
+
+        if (t->state == THREAD_DONE) {
+            sched_enqueue(h, cur, true);
+        } else if (t->joiner) {
+            // joined already
+            ret = (unsigned long)-EBUSY;
+            sched_enqueue(h, cur, true);
+        } else {
+            t->joiner = cur;
+            cur->state = THREAD_BLOCKED;
+        }
+        break;
+    }
+    case SCHED_OP_EXIT:
+        cur->state = THREAD_DONE;
+        if (cur->joiner)
+            sched_enqueue(h, cur->joiner, false);
+        break;
+    case SCHED_OP_RESCHED:
+    default:
+        sched_enqueue(h, cur, true);
+        break;
+    }
+
+    return ret;
+}
+
+unsigned long *hal_sched_trap(unsigned long mcause, unsigned long mepc,
+                              unsigned long *frame, unsigned long mstatus)
+{
+    const uint64_t start = arch_cycle();
+    sched_hart_t *h = this_hart_local(sched_hart);
+    const unsigned long switches = h->stat.switches;
+    sys_tick_t now;
+
+    if (mcause == (TRAP_CAUSE_INTERRUPT_FLAG | TRAP_CAUSE_INT_MTIME)) {
+        now = rtc_now();
+        if (sched_tick(h, now)) {
+            frame = sched_switch(h, frame, &mstatus, now);
+            ++h->stat.preemptions;
+        }
+    } else if (mcause == TRAP_CAUSE_EXC_MECALL
+               && (frame[FRAME_A0] & ~SCHED_OP_MASK) == SCHED_ECALL_MAGIC) {
+        now = rtc_now();
+        frame[FRAME_PC] = mepc + 4;
+        frame[FRAME_A0] = sched_call(h, frame, now);
+        frame = sched_switch(h, frame, &mstatus, now);
+    } else {
+        trap_handler(mcause, mepc, frame);
+        write_csr(mstatus, mstatus);
+        return frame;
+    }
+
+    sched_set_timer(h);
+    write_csr(mstatus, mstatus);
+
+    if (h->stat.switches != switches) {
+        const uint64_t d = arch_cycle() - start;
+
+        if (d < h->stat.switch_min)
+            h->stat.switch_min = d;
+        if (d > h->stat.switch_max)
+            h->stat.switch_max = d;
+        h->stat.switch_sum += d;
+    }
+
+    return frame;
+}
+
+static void __attribute__((noreturn)) sched_thread_entry(hal_thread_t *t)
+{
+    t->fn(t->arg);
+    sched_ecall(SCHED_OP_EXIT, 0, 0);
+    __builtin_unreachable();
+}
+
+static void sched_idle(void *arg)
+{
+    (void)arg;
+    for (;;)
+        wfi();
+}
+
+static hal_thread_t *sched_thread_alloc(hal_thread_fn_t fn, void *arg, unsigned prio, size_t stack_size)
+{
+    if (!stack_size)
+        stack_size = PLF_SCHED_STACK_SIZE;
+    stack_size = (stack_size + SCHED_ALIGN - 1) & ~(size_t)(SCHED_ALIGN - 1);
+    if (stack_size < 2 * TRAP_REGS_SPACE) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    hal_thread_t *t = memalign(SCHED_ALIGN, SCHED_HDR_SIZE + stack_size);
+
+    if (!t)
+        return NULL;
+
+    memset(t, 0, sizeof(*t));
+    t->fn = fn;
+    t->arg = arg;
+    t->prio = (unsigned char)prio;
+    t->hart = (unsigned short)hart_local_index();
+    t->mstatus = (read_csr(mstatus) & ~MSTATUS_MIE) | MSTATUS_MPIE | MSTATUS_MPP;
+
+    // initial trap frame: mret to sched_thread_entry(t) on the empty stack
+    unsigned long *top = (unsigned long*)((char*)t + SCHED_HDR_SIZE + stack_size);
+#if PLF_TRAP_STACK
+    unsigned long *frame = t->ctx;
+#else // PLF_TRAP_STACK
+    unsigned long *frame = top - SCHED_FRAME_REGS;
+#endif // PLF_TRAP_STACK
+    unsigned long gp, tp;
+
+    __asm__ ("mv %0, gp" : "=r"(gp));
+    __asm__ ("mv %0, tp" : "=r"(tp));
+    memset(frame, 0, TRAP_REGS_SPACE);
+    frame[FRAME_PC] = (unsigned long)sched_thread_entry;
+    frame[FRAME_SP] = (unsigned long)top;
+    frame[FRAME_GP] = gp;
+    frame[FRAME_TP] = tp;
+    frame[FRAME_A0] = (unsigned long)t;
+    t->frame = frame;
+
+    return t;
+}
+
+int hal_sched_start(unsigned prio)
+{
+    if (prio >= PLF_SCHED_PRIORITIES)
+        return -EINVAL;
+
+#if defined(PLF_MTIMER_BASE) && !defined(PLF_MTIMER_EXT)
+    // the single comparator serves hart 0 only
+    if (hart_local_index() != 0)
+        return -ENODEV;
+#endif // PLF_MTIMER_BASE && !PLF_MTIMER_EXT
+
+    sched_hart_t *h = this_hart_local(sched_hart);
+
+    if (h->current)
+        return 0;
+
+    h->idle = sched_thread_alloc(sched_idle, NULL, SCHED_IDLE_PRIO, 0);
+    if (!h->idle)
+        return -ENOMEM;
+
+    h->main.prio = (unsigned char)prio;
+    h->main.hart = (unsigned short)hart_local_index();
+    h->main.state = THREAD_READY;
+    h->stat.switch_min = UINT64_MAX;
+    h->stat.jitter_min = ~(sys_tick_t)0;
+    h->slice_end = rtc_now() + PLF_US2TICKS(PLF_SCHED_SLICE_US);
+
+    clear_csr(mstatus, MSTATUS_MIE);
+    h->current = &h->main;
+    write_csr(mtvec, (unsigned long)hal_sched_trap_entry);
+    sched_set_timer(h);
+    set_csr(mie, MIE_MTIMER);
+    set_csr(mstatus, MSTATUS_MIE);
+
+    return 0;
+}
+
+hal_thread_t *hal_thread_create(hal_thread_fn_t fn, void *arg, unsigned prio, size_t stack_size)
+{
+    sched_hart_t *h = this_hart_local(sched_hart);
+
+    if (!h->current || prio >= PLF_SCHED_PRIORITIES) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    hal_thread_t *t = sched_thread_alloc(fn, arg, prio, stack_size);
+
+    if (!t)
+        return NULL;
+
+    const unsigned long st = clear_csr(mstatus, MSTATUS_MIE);
+
+    sched_enqueue(h, t, false);
+    set_csr(mstatus, st & MSTATUS_MIE);
+
+    if (prio < h->current->prio)
+        sched_ecall(SCHED_OP_RESCHED, 0, 0);
+
+    return t;
+}
+
+// hal_sched_start() has been called on the hart: the ecalls are served by hal_sched_trap()
+static bool sched_started(void)
+{
+    return this_hart_local(sched_hart)->current != NULL;
+}
+
+void hal_sched_yield(void)
+{
+    if (sched_started())
+        sched_ecall(SCHED_OP_YIELD, 0, 0);
+}
+
+void hal_sched_sleep_until(sys_tick_t t)
+{
+    if (!sched_started()) {
+        while (rtc_now() < t)
+            ;
+        return;
+    }
+#if __riscv_xlen == 32
+    sched_ecall(SCHED_OP_SLEEP, (unsigned long)t, (unsigned long)(t >> 32));
+#else // __riscv_xlen == 32
+    sched_ecall(SCHED_OP_SLEEP, (unsigned long)t, 0);
+#endif // __riscv_xlen == 32
+}
+
+int hal_thread_join(hal_thread_t *thread)
+{
+    // the joiner is woken by the run queues of the thread's hart
+    if (!sched_started() || thread->hart != hart_local_index())
+        return -EINVAL;
+    if (thread->state != THREAD_DONE) {
+        const long ret = (long)sched_ecall(SCHED_OP_JOIN, (unsigned long)thread, 0);
+
+        if (ret)
+            return (int)ret;
+    }
+    free(thread);
+
+    return 0;
+}
+
+hal_thread_t *hal_thread_self(void)
+{
+    return this_hart_local(sched_hart)->current;
+}
+
+void hal_sched_get_stat(hal_sched_stat_t *stat)
+{
+    sched_hart_t *h = this_hart_local(sched_hart);
+    const unsigned long st = clear_csr(mstatus, MSTATUS_MIE);
+
+    *stat = h->stat;
+    set_csr(mstatus, st & MSTATUS_MIE);
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Fixed-size object pools (slab allocator)
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+
+#include "slab.h"
+
+#include "arch.h"
+#include "drivers/cache.h"
+#include "hart_local.h"
+#include "lock.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/errno.h>
+#include <unistd.h> /* sbrk() */
+
+static inline void slab_sync_out(volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_flush((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static inline void slab_sync_in(volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+// the magazine may be used from the interrupt handlers of the hart
+static inline unsigned long slab_irq_save(void)
+{
+    return clear_csr(mstatus, MSTATUS_MIE);
+}
+
+static inline void slab_irq_restore(unsigned long mstatus)
+{
+    set_csr(mstatus, mstatus & MSTATUS_MIE);
+}
+
+int hal_slab_init(hal_slab_t *slab, size_t obj_size, unsigned long count, void *region, size_t region_size)
+{
+    if (!obj_size || !count)
+        return -EINVAL;
+
+    obj_size = HAL_SLAB_OBJ_SIZE(obj_size);
+
+    if (count > ((size_t)-1 - HAL_SLAB_ALIGN) / obj_size)
+        return -EINVAL;
+
+    const size_t size = HAL_SLAB_REGION_SIZE(obj_size, count);
+
+    if (!region) {
+        region = sbrk((ptrdiff_t)size);
+        if (region == (void*)-ENOMEM)
+            return -ENOMEM;
+        region_size = size;
+    } else if (region_size < size) {
+        return -EINVAL;
+    }
+
+    memset(slab, 0, sizeof(*slab));
+
+    slab->obj_size = obj_size;
+    slab->capacity = count;
+    slab->pool.next = (char*)(((uintptr_t)region + HAL_SLAB_ALIGN - 1) & -(uintptr_t)HAL_SLAB_ALIGN);
+    slab->pool.end = slab->pool.next + obj_size * count;
+
+    slab_sync_out(slab, sizeof(*slab));
+
+    return 0;
+}
+
+// takes up to n objects from the shared pool to the magazine
+static unsigned slab_refill(hal_slab_t *slab, hal_slab_mag_t *mag, unsigned n)
+{
+    unsigned got = 0;
+
+    arch_lock(&slab->pool.lock);
+    slab_sync_in(&slab->pool, sizeof(slab->pool));
+
+    while (got < n && slab->pool.free) {
+        void *obj = slab->pool.free;
+
+        slab_sync_in(obj, sizeof(void*));
+        slab->pool.free = *(void**)obj;
+        mag->obj[mag->count++] = obj;
+        ++got;
+    }
+
+    while (got < n && slab->pool.next < slab->pool.end) {
+        mag->obj[mag->count++] = slab->pool.next;
+        slab->pool.next += slab->obj_size;
+        ++got;
+    }
+
+    slab->pool.out += got;
+    if (slab->pool.out > slab->pool.high_water)
+        slab->pool.high_water = slab->pool.out;
+
+    slab_sync_out(&slab->pool, sizeof(slab->pool));
+    arch_unlock(&slab->pool.lock);
+
+    // publish the counters for hal_slab_get_stat()
+    slab_sync_out(mag, sizeof(*mag));
+
+    return got;
+}
+
+// returns n objects from the magazine to the shared pool
+static void slab_drain(hal_slab_t *slab, hal_slab_mag_t *mag, unsigned n)
+{
+    arch_lock(&slab->pool.lock);
+    slab_sync_in(&slab->pool, sizeof(slab->pool));
+
+    for (unsigned i = 0; i < n; ++i) {
+        void *obj = mag->obj[--mag->count];
+
+        *(void**)obj = slab->pool.free;
+        slab_sync_out(obj, sizeof(void*));
+        slab->pool.free = obj;
+    }
+
+    slab->pool.out -= n;
+
+    slab_sync_out(&slab->pool, sizeof(slab->pool));
+    arch_unlock(&slab->pool.lock);
+
+    slab_sync_out(mag, sizeof(*mag));
+}
+
+void *hal_slab_alloc(hal_slab_t *slab)
+{
+    hal_slab_mag_t *mag = &slab->mag[hart_local_index()];
+    const unsigned long mstatus = slab_irq_save();
+    void *obj = NULL;
+
+    if (mag->count || slab_refill(slab, mag, (PLF_SLAB_MAGAZINE_SIZE + 1) / 2)) {
+        obj = mag->obj[--mag->count];
+        ++mag->allocs;
+    } else {
+        ++mag->failures;
+    }
+
+    slab_irq_restore(mstatus);
+
+    return obj;
+}
+
+void hal_slab_free(hal_slab_t *slab, void *obj)
+{
+    if (!obj)
+        return;
+
+    hal_slab_mag_t *mag = &slab->mag[hart_local_index()];
+    const unsigned long mstatus = slab_irq_save();
+
+    if (mag->count == PLF_SLAB_MAGAZINE_SIZE)
+        slab_drain(slab, mag, PLF_SLAB_MAGAZINE_SIZE / 2);
+
+    mag->obj[mag->count++] = obj;
+    ++mag->frees;
+
+    slab_irq_restore(mstatus);
+}
+
+void hal_slab_get_stat(hal_slab_t *slab, hal_slab_stat_t *stat)
+{
+    const unsigned self = hart_local_index();
+
+    memset(stat, 0, sizeof(*stat));
+
+    for (unsigned h = 0; h < HAL_SLAB_HARTS; ++h) {
+        if (h != self)
+            slab_sync_in(&slab->mag[h], sizeof(slab->mag[h]));
+        stat->allocs += slab->mag[h].allocs;
+        stat->frees += slab->mag[h].frees;
+        stat->failures += slab->mag[h].failures;
+    }
+
+    stat->in_use = stat->allocs - stat->frees;
+
+    arch_lock(&slab->pool.lock);
+    slab_sync_in(&slab->pool, sizeof(slab->pool));
+    stat->high_water = slab->pool.high_water;
+    arch_unlock(&slab->pool.lock);
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Spin-wait sites and statistics
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+#include "spin.h"
+
+#include "arch.h"
+#include "drivers/cache.h"
+#include "utils.h"
+
+#include <string.h>
+
+// sites with a waker may sleep, the others are limited to backoff
+arch_spin_site_t arch_spin_site_lock    = ARCH_SPIN_SITE_INIT("lock", ARCH_SPIN_WFI);
+arch_spin_site_t arch_spin_site_mcs     = ARCH_SPIN_SITE_INIT("mcs", ARCH_SPIN_WFI);
+arch_spin_site_t arch_spin_site_rwlock  = ARCH_SPIN_SITE_INIT("rwlock", ARCH_SPIN_WFI);
+arch_spin_site_t arch_spin_site_seqlock = ARCH_SPIN_SITE_INIT("seqlock", ARCH_SPIN_WFI);
+arch_spin_site_t arch_spin_site_barrier = ARCH_SPIN_SITE_INIT("barrier", ARCH_SPIN_WFI);
+arch_spin_site_t arch_spin_site_ring    = ARCH_SPIN_SITE_INIT("ring", ARCH_SPIN_BACKOFF);
+arch_spin_site_t arch_spin_site_ipi     = ARCH_SPIN_SITE_INIT("ipi", ARCH_SPIN_BACKOFF);
+arch_spin_site_t arch_spin_site_smp     = ARCH_SPIN_SITE_INIT("smp", ARCH_SPIN_BACKOFF);
+arch_spin_site_t arch_spin_site_wait    = ARCH_SPIN_SITE_INIT("wait", ARCH_SPIN_BACKOFF);
+// short delays: backoff would overshoot
+arch_spin_site_t arch_spin_site_rtc     = ARCH_SPIN_SITE_INIT("rtc", ARCH_SPIN_PAUSE);
+
+arch_spin_site_t *const arch_spin_sites[] = {
+    &arch_spin_site_lock,
+    &arch_spin_site_mcs,
+    &arch_spin_site_rwlock,
+    &arch_spin_site_seqlock,
+    &arch_spin_site_barrier,
+    &arch_spin_site_ring,
+    &arch_spin_site_ipi,
+    &arch_spin_site_smp,
+    &arch_spin_site_rtc,
+    &arch_spin_site_wait,
+};
+const unsigned arch_spin_site_count = ARRAY_SIZE(arch_spin_sites);
+
+void arch_spin_get_stat(const arch_spin_site_t *site, unsigned hart, arch_spin_stat_t *stat)
+{
+#if PLF_SPIN_STATS
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)&site->stat[hart].s, sizeof(site->stat[hart].s));
+#endif // PLF_SMP_NON_COHERENT
+    *stat = site->stat[hart].s;
+#else
+    (void)site;
+    (void)hart;
+    memset(stat, 0, sizeof(*stat));
+#endif // PLF_SPIN_STATS
+}
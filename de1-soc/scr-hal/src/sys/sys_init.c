@@ -30,6 +30,7 @@
 #include "drivers/cache.h"
 #include "drivers/console.h"
 #include "drivers/feature_enable.h"
+#include "drivers/ipi.h"
 #include "drivers/leds.h"
 #include "drivers/mpu.h"
 #include "drivers/pmp.h"
@@ -37,8 +38,11 @@
 #if PLF_MRT_SUPPORT
 #include "drivers/mrt.h"
 #endif // PLF_MRT_SUPPORT
+#include "hart_local.h"
+#include "iccm_lock.h"
 #include "memasm.h"
 #include "perf.h"
+#include "spin.h"
 #include "utils.h"
 
 #include <stdio.h>
@@ -63,6 +67,18 @@ const unsigned mem_region_count         = ARRAY_SIZE(mem_regions);
 #endif // PLF_MEM_MAP
 
 uint64_t bss_complete_cycles = 0ULL;
+uint64_t boot_cache_init_cycles = 0ULL;
+uint64_t boot_bss_init_cycles = 0ULL;
+uint64_t boot_bss_wait_cycles = 0ULL;
+uint64_t boot_tls_init_cycles = 0ULL;
+
+// HAL_PARALLEL_BSS_INIT: the secondary harts clear BSS slices in crt0 and init their own TLS
+#if PLF_SMP_SUPPORT && defined(HAL_PARALLEL_BSS_INIT)
+#define TLS_INIT_PARALLEL 1
+#ifndef HAL_SKIP_BSS_INIT
+#define BSS_INIT_PARALLEL 1
+#endif // HAL_SKIP_BSS_INIT
+#endif // PLF_SMP_SUPPORT && HAL_PARALLEL_BSS_INIT
 
 void plf_init_features(void);
 
@@ -79,6 +95,15 @@ static void plf_init_tls(void* tls)
 #endif // PLF_SMP_NON_COHERENT
 }
 
+static void plf_init_iccm_lock(void)
+{
+#if PLF_ICCM_ARCH_LOCK && PLF_ICCM_LOCK_SUPPORT
+    // the arbiter serves arch_lock() requests from its ICCM interrupt
+    if (arch_hartid() - PLF_SMP_HARTID_BASE == PLF_ICCM_LOCK_ARBITER)
+        ipi_init();
+#endif // PLF_ICCM_ARCH_LOCK && PLF_ICCM_LOCK_SUPPORT
+}
+
 // application early init callback
 __attribute__((weak)) void app_early_init(bool boot_hart) { (void)boot_hart; }
 __attribute__((weak)) const char *hal_app_exit_message = NULL;
@@ -97,8 +122,24 @@ __attribute__((weak)) void app_exit(void)
 #if PLF_SMP_SUPPORT
 volatile __attribute__((section(".data"))) int plf_smp_sync_var = 0;
 
+static inline int plf_smp_sync_var_read(void)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)&plf_smp_sync_var, sizeof(plf_smp_sync_var));
+#else  // PLF_SMP_NON_COHERENT
+    fence();
+#endif // PLF_SMP_NON_COHERENT
+    return plf_smp_sync_var;
+}
+
 void plf_smp_slave_init(void)
 {
+#if TLS_INIT_PARALLEL
+    void* tp_ptr = NULL;
+    asm volatile ("mv %0, tp;" : "=r"(tp_ptr) ::);
+    plf_init_tls(tp_ptr);
+#endif // TLS_INIT_PARALLEL
+
 #if defined(HAL_ENABLE_PERF) && (PLF_CORE_VARIANT_SCR > 1)
     perf_init_hpm();
 #endif
@@ -119,14 +160,9 @@ void plf_smp_slave_init(void)
 
     plf_init_features();
 
-    do
-    {
-#if PLF_SMP_NON_COHERENT
-        cache_l1_invalidate((void*)&plf_smp_sync_var, sizeof(plf_smp_sync_var));
-#else  // PLF_SMP_NON_COHERENT
-        fence();
-#endif // PLF_SMP_NON_COHERENT
-    } while (!plf_smp_sync_var);
+    plf_init_iccm_lock();
+
+    arch_spin_until(&arch_spin_site_smp, plf_smp_sync_var_read());
 }
 
 // allocate stack and TLS, init TLS
@@ -157,14 +193,19 @@ void PLF_SMP_SLAVE_ENTRY(void) __attribute__((weak, alias("smp_slave_entry_defau
 // "start all harts"/"end all harts" checkpoints.
 // Array is placed to data section to prevent usage of uninitialized
 // data in very early code in crt0.
+// It is not __hart_local: it is read by crt0 before BSS and .hart_local are
+// initialized and the master hart writes the entries of the other harts.
 volatile void* hart_start_table[PLF_SMP_HART_NUM] __attribute__((section(".data")));
 
 #endif // PLF_SMP_SUPPORT
 
 // The following plf_smp_init(), plf_smp_hart_finit() and plf_smp_wait_finit() functions
 // operates with hart_start_table array values. Be careful making changes to them.
-static void plf_smp_init(void)
+// returns the TLS init cycles of the secondary harts (HLS allocation is not counted)
+static uint64_t plf_smp_init(void)
 {
+    uint64_t tls_cycles = 0;
+
 #if PLF_SMP_SUPPORT
     for (int i = 0; i < PLF_SMP_HART_NUM; ++i)
     {
@@ -173,7 +214,11 @@ static void plf_smp_init(void)
             void* hls = plf_alloc_thread();
             if (hls == (void*)-ENOMEM)
                 break;
+#if !TLS_INIT_PARALLEL
+            const uint64_t t0 = arch_cycle();
             plf_init_tls(hls);
+            tls_cycles += arch_cycle() - t0;
+#endif // !TLS_INIT_PARALLEL
             hart_start_table[i] = hls;
         }
         else {
@@ -185,6 +230,8 @@ static void plf_smp_init(void)
 
     cache_l1_flush(hart_start_table, sizeof(hart_start_table));
 #endif // PLF_SMP_SUPPORT
+
+    return tls_cycles;
 }
 
 void plf_smp_hart_finit(void)
@@ -197,25 +244,29 @@ void plf_smp_hart_finit(void)
 #endif  // PLF_SMP_SUPPORT
 }
 
-void plf_smp_wait_finit(void)
-{
 #if PLF_SMP_SUPPORT
-    int i;
-    do {
+static int plf_smp_all_finit(void)
+{
 #if PLF_SMP_NON_COHERENT
-        cache_l1_invalidate(hart_start_table, sizeof(hart_start_table));
+    cache_l1_invalidate(hart_start_table, sizeof(hart_start_table));
 #else
-        fence();
+    fence();
 #endif
-        // wait until the harts signal the end of their
-        // work through the plf_smp_hart_finit()
-        for (i = 0; i < PLF_SMP_HART_NUM; ++i) {
-            if (hart_start_table[i] == (void *)-1)
-                break;
-        }
+    for (int i = 0; i < PLF_SMP_HART_NUM; ++i) {
+        if (hart_start_table[i] == (void *)-1)
+            return 0;
+    }
+
+    return 1;
+}
+#endif // PLF_SMP_SUPPORT
 
-        cpu_relax();
-    } while(i < PLF_SMP_HART_NUM);
+void plf_smp_wait_finit(void)
+{
+#if PLF_SMP_SUPPORT
+    // wait until the harts signal the end of their
+    // work through the plf_smp_hart_finit()
+    arch_spin_until(&arch_spin_site_smp, plf_smp_all_finit());
 #endif // PLF_SMP_SUPPORT
 }
 
@@ -341,42 +392,283 @@ void plf_init_features(void)
     }
 }
 
+static void __init plf_init_caches(void)
+{
+    // L3 and L2 invalidations are independent: run them in parallel
+    plf_l3cache_init_start();
+    plf_l2cache_init_start();
+    plf_l3cache_init_wait();
+    plf_l2cache_init_finish();
+    plf_l1cache_init();
+}
+
+static void __init plf_init_bss_range(char *start, char *end)
+{
+#ifdef HAL_SKIP_BSS_INIT
+    (void)end;
+    memset_optnone(start, 0, 0);
+#elif defined(HAL_EARLY_CACHE_INIT)
+    // caches are on: use cbo.zero if supported
+    cache_memset(start, 0, (size_t)(end - start));
+#else
+    memset_optnone(start, 0, (size_t)(end - start));
+#endif // HAL_SKIP_BSS_INIT
+#if !defined(HAL_SKIP_BSS_INIT) && (PLF_SMP_NON_COHERENT || PLF_ICCM_L3_SUPPORT)
+    // the zeroes may stay in L1 (caches on): write them back for the other harts and L3/ICCM
+    cache_l1_flush(start, end - start);
+#endif // !HAL_SKIP_BSS_INIT && (PLF_SMP_NON_COHERENT || PLF_ICCM_L3_SUPPORT)
+}
+
+#ifdef HAL_SKIP_BSS_INIT
+// hart-local data (MCS lock nodes, scheduler, PMU snapshots) relies on zero init:
+// clear it even if BSS is not, the section is small
+static void __init plf_init_hart_local(void)
+{
+#if PLF_SMP_SUPPORT
+    const size_t size = hart_local_stride() * PLF_SMP_HART_NUM;
+#else // PLF_SMP_SUPPORT
+    const size_t size = hart_local_stride();
+#endif // PLF_SMP_SUPPORT
+
+    memset(__hart_local_start, 0, size);
+#if (PLF_SMP_NON_COHERENT || PLF_ICCM_L3_SUPPORT)
+    cache_l1_flush(__hart_local_start, size);
+#endif // PLF_SMP_NON_COHERENT || PLF_ICCM_L3_SUPPORT
+}
+#endif // HAL_SKIP_BSS_INIT
+
+extern char __ocram_start[], __ocram_end[];
+extern char __tcm_start[], __tcm_end[];
+extern char __ddr_start[], __ddr_end[];
+
+// zero a region section: caches are on, not skipped by HAL_SKIP_BSS_INIT
+static void __init plf_init_mem_region(char *start, char *end)
+{
+    cache_memset(start, 0, (size_t)(end - start));
+#if (PLF_SMP_NON_COHERENT || PLF_ICCM_L3_SUPPORT)
+    cache_l1_flush(start, end - start);
+#endif // PLF_SMP_NON_COHERENT || PLF_ICCM_L3_SUPPORT
+}
+
+// region placed data (mem_region.h), the regions are accessible after MPU/PMP init
+static void __init plf_init_mem_regions(void)
+{
+    plf_init_mem_region(__ocram_start, __ocram_end);
+    plf_init_mem_region(__tcm_start, __tcm_end);
+    plf_init_mem_region(__ddr_start, __ddr_end);
+}
+
+#if BSS_INIT_PARALLEL
+// time the master hart waits for the secondary harts to check in
+#ifndef PLF_SMP_BSS_CHECKIN_CYCLES
+#define PLF_SMP_BSS_CHECKIN_CYCLES (100000)
+#endif
+
+// BSS slices {begin, end, present} cleared by the secondary harts in crt0 (secondary_spin_wait):
+// the hart sets present and waits for end, the master hart sets begin and then end,
+// the hart replaces begin with the slice clear cycles and zeroes end when done.
+// Absent or parked harts do not check in in time: the master hart clears their part
+// and gives them an empty slice, so a late hart does not touch BSS
+volatile uintptr_t plf_bss_slice[PLF_SMP_HART_NUM][4] __attribute__((section(".data"), aligned(4 * sizeof(uintptr_t))));
+
+// harts the slices were given to
+static unsigned long plf_bss_harts;
+
+// relocating build: crt0 does not use plf_bss_slice before plf_init_relocate()
+extern char __reldata_start[] __attribute__((weak));
+extern char __reldata_load_start[] __attribute__((weak));
+
+static char *volatile const plf_bss_reldata[2] = {__reldata_start, __reldata_load_start};
+
+static void plf_bss_slice_sync_in(void)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)plf_bss_slice, sizeof(plf_bss_slice));
+#else
+    fence();
+#endif
+}
+
+static unsigned long __init plf_bss_harts_present(void)
+{
+    const unsigned long all = (PLF_SMP_HART_NUM < __riscv_xlen) ? (1UL << PLF_SMP_HART_NUM) - 1 : ~0UL;
+    const unsigned long master = 1UL << (PLF_SMP_MASTER_HARTID - PLF_SMP_HARTID_BASE);
+    const uint64_t t0 = arch_cycle();
+    unsigned long present;
+
+    if (plf_bss_reldata[0] != plf_bss_reldata[1])
+        return master;
+
+    do {
+        plf_bss_slice_sync_in();
+        present = master;
+        for (unsigned i = 0; i < PLF_SMP_HART_NUM; ++i) {
+            if (plf_bss_slice[i][2])
+                present |= 1UL << i;
+        }
+    } while (present != all && (arch_cycle() - t0) < PLF_SMP_BSS_CHECKIN_CYCLES);
+
+    return present;
+}
+
+static int plf_bss_slices_done(unsigned long harts)
+{
+    plf_bss_slice_sync_in();
+    for (unsigned i = 0; i < PLF_SMP_HART_NUM; ++i) {
+        if ((harts & (1UL << i)) && plf_bss_slice[i][1])
+            return 0;
+    }
+
+    return 1;
+}
+
+static void __init plf_init_bss(void)
+{
+    const unsigned master = PLF_SMP_MASTER_HARTID - PLF_SMP_HARTID_BASE;
+    // the slices are cache line aligned, the master hart clears the unaligned head and tail
+    char *head = (char*)(((uintptr_t)__bss_start + PLF_MAX_CACHELINE_SIZE - 1) & -(uintptr_t)PLF_MAX_CACHELINE_SIZE);
+    char *tail = (char*)((uintptr_t)__bss_end & -(uintptr_t)PLF_MAX_CACHELINE_SIZE);
+
+    if (head >= tail)
+        head = tail = __bss_end;
+
+    const uint64_t lines = (uint64_t)(tail - head) / PLF_MAX_CACHELINE_SIZE;
+    const unsigned long harts = plf_bss_harts_present();
+    const unsigned nharts = (unsigned)__builtin_popcountl(harts);
+    char *own_begin = head;
+    char *own_end = head;
+
+    for (unsigned i = 0, n = 0; i < PLF_SMP_HART_NUM; ++i) {
+        // a hart that has not checked in gets an empty slice: a late hart does not touch BSS
+        char *b = head;
+        char *e = head;
+
+        if (harts & (1UL << i)) {
+            b = head + lines * n / nharts * PLF_MAX_CACHELINE_SIZE;
+            e = head + lines * (n + 1) / nharts * PLF_MAX_CACHELINE_SIZE;
+            ++n;
+        }
+        if (i == master) {
+            own_begin = b;
+            own_end = e;
+            e = NULL;
+        }
+        plf_bss_slice[i][0] = (uintptr_t)b;
+        // release the hart: a nonzero end (even of an empty slice) after begin
+        __asm__ __volatile__ ("fence w , w\n" ::: "memory");
+        plf_bss_slice[i][1] = (uintptr_t)e;
+    }
+    cache_l1_flush((void*)plf_bss_slice, sizeof(plf_bss_slice));
+
+    plf_init_bss_range(__bss_start, head);
+    plf_init_bss_range(own_begin, own_end);
+    plf_init_bss_range(tail, __bss_end);
+
+    const uint64_t t0 = arch_cycle();
+    arch_spin_until(&arch_spin_site_smp, plf_bss_slices_done(harts));
+    boot_bss_wait_cycles = arch_cycle() - t0;
+    plf_bss_harts = harts; // BSS is cleared
+
+#if PLF_SMP_NON_COHERENT || PLF_ICCM_L3_SUPPORT
+    // own slice and the partial head and tail lines are written back by plf_init_bss_range(),
+    // drop the lines of the other slices fetched (e.g. prefetched) before they were cleared
+    if (own_begin != head)
+        cache_l1_invalidate(head, own_begin - head);
+    if (own_end != tail)
+        cache_l1_invalidate(own_end, tail - own_end);
+#endif // PLF_SMP_NON_COHERENT || PLF_ICCM_L3_SUPPORT
+}
+
+uint64_t get_boot_bss_hart_cycles(unsigned hart)
+{
+    if (hart >= PLF_SMP_HART_NUM || hart == PLF_SMP_MASTER_HARTID - PLF_SMP_HARTID_BASE
+        || !(plf_bss_harts & (1UL << hart)))
+        return 0;
+    return plf_bss_slice[hart][0];
+}
+#else // BSS_INIT_PARALLEL
+static void __init plf_init_bss(void)
+{
+    plf_init_bss_range(__bss_start, __bss_end);
+}
+
+uint64_t get_boot_bss_hart_cycles(unsigned hart)
+{
+    (void)hart;
+    return 0;
+}
+#endif // BSS_INIT_PARALLEL
+
 void __init plf_init_generic(void)
 {
+    uint64_t cache_cycles;
+    uint64_t bss_cycles;
+    uint64_t tls_cycles;
+    uint64_t t0;
+
     // do relocations
     plf_init_relocate();
+
+#ifdef HAL_EARLY_CACHE_INIT
+    // enable caches and memory attributes first,
+    // so TLS and BSS are initialized with caches on
+    pmp_early_init();
+
+    t0 = arch_cycle();
+    plf_init_caches();
+    cache_cycles = arch_cycle() - t0;
+
+    // enable/init MPU
+    mpu_init();
+
+    pmp_init();
+#endif // HAL_EARLY_CACHE_INIT
+
     // init TLS
     void* tp_ptr = NULL;
     asm volatile ("mv %0, tp;" : "=r"(tp_ptr) ::);
+    t0 = arch_cycle();
     plf_init_tls(tp_ptr);
+    tls_cycles = arch_cycle() - t0;
 
 #if defined(HAL_ENABLE_PERF) && (PLF_CORE_VARIANT_SCR > 1)
     perf_init_hpm();
 #endif
 
     // init BSS
+    t0 = arch_cycle();
+    plf_init_bss();
 #ifdef HAL_SKIP_BSS_INIT
-    memset_optnone(__bss_start, 0, 0);
-#else
-    memset_optnone(__bss_start, 0, (size_t)(__bss_end - __bss_start));
+    plf_init_hart_local();
 #endif // HAL_SKIP_BSS_INIT
+    bss_cycles = arch_cycle() - t0;
 
     bss_complete_cycles = arch_cycle();
 
+#ifndef HAL_EARLY_CACHE_INIT
     pmp_early_init();
+#endif // !HAL_EARLY_CACHE_INIT
 
     // application early init callback
     app_early_init(true);
 
+#ifndef HAL_EARLY_CACHE_INIT
     // enable/init caches
-    plf_l3cache_init();
-    plf_l2cache_init();
-    plf_l1cache_init();
+    t0 = arch_cycle();
+    plf_init_caches();
+    cache_cycles = arch_cycle() - t0;
 
     // enable/init MPU
     mpu_init();
 
     pmp_init();
+#endif // !HAL_EARLY_CACHE_INIT
+
+    plf_init_mem_regions();
+
+    boot_cache_init_cycles = cache_cycles;
+    boot_bss_init_cycles = bss_cycles;
+    boot_tls_init_cycles = tls_cycles;
 
 #if PLF_MRT_SUPPORT
     mrt_init();
@@ -391,8 +683,10 @@ void __init plf_init_generic(void)
     leds_init();
 #endif
 
+    plf_init_iccm_lock();
+
     // init smp
-    plf_smp_init();
+    boot_tls_init_cycles += plf_smp_init();
 }
 
 void plf_init(void) __attribute__((weak, alias("plf_init_generic")));
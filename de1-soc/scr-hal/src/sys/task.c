@@ -0,0 +1,388 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Work-stealing task scheduler
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+
+#include "task.h"
+
+#include "arch.h"
+#include "atomic.h"
+#include "drivers/cache.h"
+#include "drivers/ipi.h"
+#include "hart_local.h"
+#include "spin.h"
+#include "wait.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if (PLF_TASK_DEQUE_SIZE & (PLF_TASK_DEQUE_SIZE - 1)) != 0
+#error PLF_TASK_DEQUE_SIZE must be a power of 2
+#endif
+
+#ifdef PLF_MAX_CACHELINE_SIZE
+#define TASK_ALIGN __attribute__((aligned(PLF_MAX_CACHELINE_SIZE)))
+#else
+#define TASK_ALIGN __attribute__((aligned(64)))
+#endif
+
+typedef struct {
+    hal_task_fn_t fn;
+    void *arg;
+    hal_task_group_t *group;
+} task_t;
+
+// written by the owner hart only
+typedef struct {
+    hal_task_stat_t stat;
+    uint32_t rnd; // victim selection state
+} TASK_ALIGN task_hart_t;
+
+static __hart_local task_hart_t task_hart;
+
+static void task_sync_out(volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_flush((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static void task_run(const task_t *t, task_hart_t *h)
+{
+    t->fn(t->arg);
+    ++h->stat.tasks;
+    // release: the task results are visible before the group completion
+    atomic_add_release(-1, &t->group->pending);
+}
+
+void hal_task_get_stat(unsigned hart, hal_task_stat_t *stat)
+{
+    const task_hart_t *h = hart_local_ptr(task_hart, hart);
+
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)h, sizeof(*h));
+#endif // PLF_SMP_NON_COHERENT
+    *stat = h->stat;
+}
+
+#if defined(PLF_SMP_SUPPORT) && PLF_ATOMIC_SUPPORTED
+
+static inline void task_sync_in(volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+// indices grow monotonically and are compared by the wrapping difference
+typedef struct {
+    struct {
+        arch_atomic_t top;      // steal end
+    } TASK_ALIGN steal;
+    struct {
+        volatile unsigned bottom; // owner end
+    } TASK_ALIGN own;
+    task_t slot[PLF_TASK_DEQUE_SIZE];
+} TASK_ALIGN task_deque_t;
+
+static __hart_local task_deque_t task_deque;
+
+static struct {
+    arch_atomic_t epoch;    // incremented to wake up the sleeping workers
+    arch_atomic_t sleepers; // number of workers in hal_wait_on()
+    arch_atomic_t stop;
+} TASK_ALIGN task_sched;
+
+static inline unsigned task_self(void)
+{
+    return (unsigned)(arch_hartid() - PLF_SMP_HARTID_BASE);
+}
+
+static inline unsigned task_top(task_deque_t *d)
+{
+    return (unsigned)atomic_read(&d->steal.top);
+}
+
+static inline unsigned task_bottom(task_deque_t *d)
+{
+    task_sync_in(&d->own.bottom, sizeof(d->own.bottom));
+    return d->own.bottom;
+}
+
+static inline void task_set_bottom(task_deque_t *d, unsigned b)
+{
+    d->own.bottom = b;
+    task_sync_out(&d->own.bottom, sizeof(d->own.bottom));
+}
+
+static bool task_push(task_deque_t *d, const task_t *t)
+{
+    const unsigned b = d->own.bottom;
+
+    if (b - task_top(d) >= PLF_TASK_DEQUE_SIZE)
+        return false;
+
+    task_t *s = &d->slot[b & (PLF_TASK_DEQUE_SIZE - 1)];
+
+    *s = *t;
+    task_sync_out(s, sizeof(*s));
+
+    // release: the slot is visible before the new bottom
+    __asm__ __volatile__ ("fence rw , w\n" ::: "memory");
+
+    task_set_bottom(d, b + 1);
+
+    return true;
+}
+
+static bool task_pop(task_deque_t *d, task_t *t)
+{
+    const unsigned b = d->own.bottom - 1;
+
+    task_set_bottom(d, b);
+
+    // the bottom update is ordered before the top read, see task_steal()
+    fence();
+
+    const unsigned top = task_top(d);
+    const int n = (int)(b - top);
+
+    if (n < 0) {
+        task_set_bottom(d, b + 1);
+        return false;
+    }
+
+    *t = d->slot[b & (PLF_TASK_DEQUE_SIZE - 1)];
+
+    if (n > 0)
+        return true;
+
+    // the last task: race with the thieves for it
+    const bool won = atomic_cas_seq_cst(&d->steal.top, (int)top, (int)(top + 1));
+
+    task_set_bottom(d, b + 1);
+
+    return won;
+}
+
+static bool task_steal(task_deque_t *d, task_t *t)
+{
+    const unsigned top = task_top(d);
+
+    fence();
+
+    if ((int)(task_bottom(d) - top) <= 0)
+        return false;
+
+    // acquire: the slot is read after the bottom that published it, a control
+    // dependency does not order load -> load
+    __asm__ __volatile__ ("fence r , r\n" ::: "memory");
+
+    task_t *s = &d->slot[top & (PLF_TASK_DEQUE_SIZE - 1)];
+
+    task_sync_in(s, sizeof(*s));
+    *t = *s;
+
+    // the slot can not be reused by the owner until the top is advanced
+    return atomic_cas_seq_cst(&d->steal.top, (int)top, (int)(top + 1));
+}
+
+static inline uint32_t task_random(task_hart_t *h)
+{
+    uint32_t x = h->rnd ? h->rnd : (uint32_t)arch_hartid() * 2654435761U + 1;
+
+    // xorshift32
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    h->rnd = x;
+
+    return x;
+}
+
+static bool task_find(task_t *t, task_hart_t *h)
+{
+    if (task_pop(this_hart_local(task_deque), t))
+        return true;
+
+    // a random victim first, then the rest of the harts in order
+    const unsigned self = task_self();
+    unsigned v = task_random(h) % PLF_SMP_HART_NUM;
+
+    for (unsigned i = 0; i < PLF_SMP_HART_NUM; ++i, v = (v + 1) % PLF_SMP_HART_NUM) {
+        if (v != self && task_steal(hart_local_ptr(task_deque, v), t)) {
+            ++h->stat.steals;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool task_available(void)
+{
+    for (unsigned v = 0; v < PLF_SMP_HART_NUM; ++v) {
+        task_deque_t *d = hart_local_ptr(task_deque, v);
+
+        if ((int)(task_bottom(d) - task_top(d)) > 0)
+            return true;
+    }
+
+    return false;
+}
+
+static void task_sleep(void)
+{
+    const int epoch = atomic_read(&task_sched.epoch);
+
+    atomic_add_seq_cst(1, &task_sched.sleepers);
+
+    // a concurrent hal_task_spawn() either sees the sleeper or its task is seen here
+    if (!task_available() && !atomic_read(&task_sched.stop))
+        hal_wait_on(&task_sched.epoch.counter, epoch);
+
+    atomic_add_seq_cst(-1, &task_sched.sleepers);
+}
+
+static void task_wake(unsigned n)
+{
+    atomic_add_seq_cst(1, &task_sched.epoch);
+    hal_wake(&task_sched.epoch.counter, n);
+}
+
+void hal_task_spawn(hal_task_group_t *g, hal_task_fn_t fn, void *arg)
+{
+    const task_t t = {fn, arg, g};
+
+    atomic_add(1, &g->pending);
+
+    if (!task_push(this_hart_local(task_deque), &t)) {
+        task_run(&t, this_hart_local(task_hart));
+        return;
+    }
+
+    // the new bottom is visible before the sleepers check, see task_sleep()
+    fence();
+
+    if (atomic_read(&task_sched.sleepers))
+        task_wake(1);
+}
+
+void hal_task_sync(hal_task_group_t *g)
+{
+    task_hart_t *h = this_hart_local(task_hart);
+    task_t t;
+
+    while (atomic_read(&g->pending)) {
+        if (task_find(&t, h)) {
+            task_run(&t, h);
+            continue;
+        }
+
+        const uint64_t t0 = arch_cycle();
+
+        arch_spin_pause();
+        h->stat.idle_cycles += arch_cycle() - t0;
+    }
+
+    // acquire barrier
+    __asm__ __volatile__ ("fence r , rw\n" ::: "memory");
+
+    task_sync_out(h, sizeof(*h));
+}
+
+void hal_task_worker(void)
+{
+    task_hart_t *h = this_hart_local(task_hart);
+    unsigned misses = 0;
+    task_t t;
+
+#if PLF_IPI_SUPPORT
+    // sleep in WFI instead of polling in hal_wait_on()
+    ipi_init();
+#endif // PLF_IPI_SUPPORT
+
+    while (!atomic_read(&task_sched.stop)) {
+        if (task_find(&t, h)) {
+            task_run(&t, h);
+            misses = 0;
+            continue;
+        }
+
+        const uint64_t t0 = arch_cycle();
+
+        if (++misses < PLF_TASK_IDLE_SPINS) {
+            arch_spin_pause();
+        } else {
+            task_sleep();
+            misses = 0;
+        }
+        h->stat.idle_cycles += arch_cycle() - t0;
+    }
+
+    task_sync_out(h, sizeof(*h));
+}
+
+void hal_task_shutdown(void)
+{
+    atomic_set(&task_sched.stop, 1);
+    task_wake(HAL_WAKE_ALL);
+}
+
+#else // PLF_SMP_SUPPORT && PLF_ATOMIC_SUPPORTED
+
+void hal_task_spawn(hal_task_group_t *g, hal_task_fn_t fn, void *arg)
+{
+    const task_t t = {fn, arg, g};
+
+    atomic_add(1, &g->pending);
+    task_run(&t, this_hart_local(task_hart));
+    task_sync_out(this_hart_local(task_hart), sizeof(task_hart));
+}
+
+void hal_task_sync(hal_task_group_t *g)
+{
+    (void)g;
+}
+
+void hal_task_worker(void)
+{
+}
+
+void hal_task_shutdown(void)
+{
+}
+
+#endif // PLF_SMP_SUPPORT && PLF_ATOMIC_SUPPORTED
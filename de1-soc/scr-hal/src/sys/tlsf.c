@@ -0,0 +1,748 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief TLSF (Two-Level Segregated Fit) allocator
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#include "tlsf.h"
+
+#include "arch.h"
+#include "lock.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/errno.h>
+#include <unistd.h> /* sbrk() */
+
+#define TLSF_ALIGN_LOG2 4
+#define TLSF_ALIGN      (1U << TLSF_ALIGN_LOG2)
+
+// second level: 2^PLF_TLSF_SL_LOG2 lists per power of 2
+#define TLSF_SL_COUNT   (1U << PLF_TLSF_SL_LOG2)
+// blocks below TLSF_SMALL are mapped linearly to the first level 0
+#define TLSF_FL_SHIFT   (PLF_TLSF_SL_LOG2 + TLSF_ALIGN_LOG2)
+#define TLSF_SMALL      (1UL << TLSF_FL_SHIFT)
+// max block size is 2^TLSF_FL_MAX
+#if __riscv_xlen == 64
+#define TLSF_FL_MAX     36
+#else
+#define TLSF_FL_MAX     30
+#endif
+#define TLSF_FL_COUNT   (TLSF_FL_MAX - TLSF_FL_SHIFT + 1)
+#define TLSF_MAX_SIZE   (((size_t)1 << TLSF_FL_MAX) - TLSF_ALIGN)
+
+#if TLSF_SL_COUNT > 32
+#error PLF_TLSF_SL_LOG2 is too big
+#endif
+
+// size flags
+#define TLSF_FREE       ((size_t)1)
+#define TLSF_PREV_FREE  ((size_t)2)
+#define TLSF_FLAGS      (TLSF_FREE | TLSF_PREV_FREE)
+
+// the payload follows the header, the last block of a pool is a zero size used sentinel
+typedef struct tlsf_block {
+    struct tlsf_block *prev_phys; // valid if TLSF_PREV_FREE
+    size_t size;                  // payload size | flags
+} __attribute__((aligned(TLSF_ALIGN))) tlsf_block_t;
+
+// free block payload
+typedef struct {
+    tlsf_block_t *next;
+    tlsf_block_t *prev;
+} tlsf_links_t;
+
+#define TLSF_HDR       sizeof(tlsf_block_t)
+#define TLSF_MIN_SIZE  ((sizeof(tlsf_links_t) + TLSF_ALIGN - 1) & ~(size_t)(TLSF_ALIGN - 1))
+
+struct hal_tlsf_heap {
+    arch_lock_t lock;
+    bool grow; // from sbrk()
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[TLSF_FL_COUNT];
+    tlsf_block_t *blocks[TLSF_FL_COUNT][TLSF_SL_COUNT];
+    struct {
+        tlsf_block_t *first;
+        size_t size;
+    } pool[PLF_TLSF_MAX_POOLS];
+    unsigned pools;
+    size_t total;
+    size_t used;
+    size_t peak_used;
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long failures;
+};
+
+typedef struct hal_tlsf_heap tlsf_heap_t;
+
+// malloc() heap
+static tlsf_heap_t tlsf_default = { .grow = true };
+
+__attribute__((weak)) void hal_tlsf_corruption(void *ptr)
+{
+    (void)ptr;
+    abort();
+}
+
+static inline unsigned tlsf_fls(size_t x)
+{
+    return (unsigned)(sizeof(unsigned long) * 8) - 1 - (unsigned)__builtin_clzl((unsigned long)x);
+}
+
+static inline unsigned tlsf_ffs(uint32_t x)
+{
+    return (unsigned)__builtin_ctz(x);
+}
+
+static inline size_t tlsf_size(const tlsf_block_t *b)
+{
+    return b->size & ~TLSF_FLAGS;
+}
+
+static inline tlsf_links_t *tlsf_links(tlsf_block_t *b)
+{
+    return (tlsf_links_t*)(b + 1);
+}
+
+static inline tlsf_block_t *tlsf_from_ptr(const void *ptr)
+{
+    return (tlsf_block_t*)ptr - 1;
+}
+
+static inline tlsf_block_t *tlsf_next_phys(const tlsf_block_t *b)
+{
+    return (tlsf_block_t*)((char*)(b + 1) + tlsf_size(b));
+}
+
+static inline size_t tlsf_adjust(size_t size)
+{
+    size = (size + TLSF_ALIGN - 1) & ~(size_t)(TLSF_ALIGN - 1);
+
+    return (size < TLSF_MIN_SIZE) ? TLSF_MIN_SIZE : size;
+}
+
+static inline void tlsf_mapping(size_t size, unsigned *fl, unsigned *sl)
+{
+    if (size < TLSF_SMALL) {
+        *fl = 0;
+        *sl = (unsigned)(size / (TLSF_SMALL / TLSF_SL_COUNT));
+    } else {
+        const unsigned f = tlsf_fls(size);
+
+        *sl = (unsigned)(size >> (f - PLF_TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+        *fl = f - (TLSF_FL_SHIFT - 1);
+    }
+}
+
+// the first list with all blocks >= size
+static inline void tlsf_mapping_search(size_t size, unsigned *fl, unsigned *sl)
+{
+    if (size >= TLSF_SMALL)
+        size += ((size_t)1 << (tlsf_fls(size) - PLF_TLSF_SL_LOG2)) - 1;
+
+    tlsf_mapping(size, fl, sl);
+}
+
+static void tlsf_remove_free(tlsf_heap_t *h, tlsf_block_t *b, unsigned fl, unsigned sl)
+{
+    tlsf_links_t *l = tlsf_links(b);
+
+    if (l->prev)
+        tlsf_links(l->prev)->next = l->next;
+    else
+        h->blocks[fl][sl] = l->next;
+
+    if (l->next)
+        tlsf_links(l->next)->prev = l->prev;
+
+    if (!h->blocks[fl][sl]) {
+        h->sl_bitmap[fl] &= ~(1U << sl);
+        if (!h->sl_bitmap[fl])
+            h->fl_bitmap &= ~(1U << fl);
+    }
+}
+
+static void tlsf_insert_free(tlsf_heap_t *h, tlsf_block_t *b)
+{
+    unsigned fl, sl;
+
+    tlsf_mapping(tlsf_size(b), &fl, &sl);
+
+    tlsf_links_t *l = tlsf_links(b);
+
+    l->prev = NULL;
+    l->next = h->blocks[fl][sl];
+    if (l->next)
+        tlsf_links(l->next)->prev = b;
+    h->blocks[fl][sl] = b;
+
+    h->sl_bitmap[fl] |= 1U << sl;
+    h->fl_bitmap |= 1U << fl;
+}
+
+static void tlsf_remove(tlsf_heap_t *h, tlsf_block_t *b)
+{
+    unsigned fl, sl;
+
+    tlsf_mapping(tlsf_size(b), &fl, &sl);
+    tlsf_remove_free(h, b, fl, sl);
+}
+
+// sets the free state of the block and the prev free flag of the next one
+static void tlsf_mark(tlsf_block_t *b, bool free)
+{
+    tlsf_block_t *next = tlsf_next_phys(b);
+
+    if (free) {
+        b->size |= TLSF_FREE;
+        next->size |= TLSF_PREV_FREE;
+        next->prev_phys = b;
+    } else {
+        b->size &= ~TLSF_FREE;
+        next->size &= ~TLSF_PREV_FREE;
+    }
+}
+
+// splits size bytes off the block, returns the remainder (free, not in a list)
+static tlsf_block_t *tlsf_split(tlsf_block_t *b, size_t size)
+{
+    tlsf_block_t *rem = (tlsf_block_t*)((char*)(b + 1) + size);
+
+    rem->size = tlsf_size(b) - size - TLSF_HDR;
+    b->size = size | (b->size & TLSF_FLAGS);
+    tlsf_mark(rem, true);
+
+    return rem;
+}
+
+// b absorbs its next physical block
+static void tlsf_absorb(tlsf_block_t *b, tlsf_block_t *next)
+{
+    b->size += tlsf_size(next) + TLSF_HDR;
+
+    tlsf_block_t *after = tlsf_next_phys(b);
+
+    if (b->size & TLSF_FREE)
+        after->prev_phys = b;
+}
+
+static tlsf_block_t *tlsf_merge(tlsf_heap_t *h, tlsf_block_t *b)
+{
+    if (b->size & TLSF_PREV_FREE) {
+        tlsf_block_t *prev = b->prev_phys;
+
+        tlsf_remove(h, prev);
+        tlsf_absorb(prev, b);
+        b = prev;
+    }
+
+    tlsf_block_t *next = tlsf_next_phys(b);
+
+    if (next->size & TLSF_FREE) {
+        tlsf_remove(h, next);
+        tlsf_absorb(b, next);
+    }
+
+    return b;
+}
+
+// returns the tail of a used block to the free lists
+static void tlsf_trim_used(tlsf_heap_t *h, tlsf_block_t *b, size_t size)
+{
+    if (tlsf_size(b) >= size + TLSF_HDR + TLSF_MIN_SIZE) {
+        tlsf_block_t *rem = tlsf_split(b, size);
+
+        tlsf_insert_free(h, tlsf_merge(h, rem));
+    }
+}
+
+static tlsf_block_t *tlsf_find(tlsf_heap_t *h, size_t size)
+{
+    unsigned fl, sl;
+
+    tlsf_mapping_search(size, &fl, &sl);
+    if (fl >= TLSF_FL_COUNT)
+        return NULL;
+
+    uint32_t sl_map = h->sl_bitmap[fl] & (~0U << sl);
+
+    if (!sl_map) {
+        const uint32_t fl_map = (fl + 1 < 32) ? h->fl_bitmap & (~0U << (fl + 1)) : 0;
+
+        if (!fl_map)
+            return NULL;
+        fl = tlsf_ffs(fl_map);
+        sl_map = h->sl_bitmap[fl];
+    }
+
+    sl = tlsf_ffs(sl_map);
+
+    tlsf_block_t *b = h->blocks[fl][sl];
+
+    tlsf_remove_free(h, b, fl, sl);
+
+    return b;
+}
+
+// takes a free block (removed from the lists), returns the used block of size bytes
+static void *tlsf_use(tlsf_heap_t *h, tlsf_block_t *b, size_t size)
+{
+    if (tlsf_size(b) >= size + TLSF_HDR + TLSF_MIN_SIZE)
+        tlsf_insert_free(h, tlsf_split(b, size));
+
+    tlsf_mark(b, false);
+
+    h->used += tlsf_size(b) + TLSF_HDR;
+    if (h->used > h->peak_used)
+        h->peak_used = h->used;
+    ++h->allocs;
+
+    return b + 1;
+}
+
+static int tlsf_add_pool(tlsf_heap_t *h, void *mem, size_t size)
+{
+    tlsf_block_t *b = (tlsf_block_t*)(((uintptr_t)mem + TLSF_ALIGN - 1) & -(uintptr_t)TLSF_ALIGN);
+
+    if (size < (size_t)((char*)b - (char*)mem) + 2 * TLSF_HDR + TLSF_MIN_SIZE ||
+        h->pools == PLF_TLSF_MAX_POOLS)
+        return -EINVAL;
+
+    size = (size - (size_t)((char*)b - (char*)mem)) & ~(size_t)(TLSF_ALIGN - 1);
+    if (size - 2 * TLSF_HDR > TLSF_MAX_SIZE)
+        size = TLSF_MAX_SIZE + 2 * TLSF_HDR;
+
+    // a free block and the used zero size sentinel
+    b->prev_phys = NULL;
+    b->size = size - 2 * TLSF_HDR;
+
+    tlsf_block_t *sentinel = tlsf_next_phys(b);
+
+    sentinel->size = 0;
+    tlsf_mark(b, true);
+    tlsf_insert_free(h, b);
+
+    h->pool[h->pools].first = b;
+    h->pool[h->pools].size = size;
+    ++h->pools;
+    h->total += size;
+
+    return 0;
+}
+
+// a new pool from sbrk() big enough for a block of size bytes aligned to align
+static bool tlsf_grow(tlsf_heap_t *h, size_t size, size_t align)
+{
+    if (!h->grow)
+        return false;
+
+    size_t grow = size + align + 3 * TLSF_HDR + TLSF_MIN_SIZE;
+
+    if (grow < PLF_TLSF_GROW_SIZE)
+        grow = PLF_TLSF_GROW_SIZE;
+
+    grow = (grow + TLSF_ALIGN - 1) & ~(size_t)(TLSF_ALIGN - 1);
+
+    const unsigned last = h->pools - 1;
+    char *end = h->pools ? (char*)h->pool[last].first + h->pool[last].size : NULL;
+
+    // no room for a new pool: only the last pool can be extended
+    if (h->pools == PLF_TLSF_MAX_POOLS &&
+        (sbrk(0) != end || h->pool[last].size + grow > TLSF_MAX_SIZE))
+        return false;
+
+    char *mem = sbrk((ptrdiff_t)grow);
+
+    if (mem == (void*)-ENOMEM)
+        return false;
+
+    // sbrk() is contiguous unless shared: the old sentinel becomes the header of the new free space
+    if (h->pools) {
+        if (mem == end && h->pool[last].size + grow <= TLSF_MAX_SIZE) {
+            tlsf_block_t *b = (tlsf_block_t*)end - 1;
+
+            b->size = (grow - TLSF_HDR) | (b->size & TLSF_PREV_FREE);
+            tlsf_next_phys(b)->size = 0;
+            tlsf_mark(b, true);
+            tlsf_insert_free(h, tlsf_merge(h, b));
+
+            h->pool[last].size += grow;
+            h->total += grow;
+
+            return true;
+        }
+    }
+
+    if (tlsf_add_pool(h, mem, grow) == 0)
+        return true;
+
+    // the break was moved by someone else meanwhile: give the chunk back if it is still the last one
+    if (sbrk(0) == mem + grow)
+        sbrk(-(ptrdiff_t)grow);
+
+    return false;
+}
+
+#if PLF_TLSF_CHECK
+// the block and its neighbours are consistent
+static void tlsf_check_block(const void *ptr)
+{
+    const tlsf_block_t *b = tlsf_from_ptr(ptr);
+    const tlsf_block_t *next = tlsf_next_phys(b);
+
+    if ((uintptr_t)ptr & (TLSF_ALIGN - 1) || (b->size & TLSF_FREE) || (next->size & TLSF_PREV_FREE) ||
+        ((b->size & TLSF_PREV_FREE) && (!(b->prev_phys->size & TLSF_FREE) || tlsf_next_phys(b->prev_phys) != b)))
+        hal_tlsf_corruption((void*)ptr);
+}
+#else
+#define tlsf_check_block(ptr) do { (void)(ptr); } while (0)
+#endif // PLF_TLSF_CHECK
+
+int hal_tlsf_add_pool(void *mem, size_t size)
+{
+    tlsf_heap_t *h = &tlsf_default;
+
+    arch_lock(&h->lock);
+    const int rc = tlsf_add_pool(h, mem, size);
+    arch_unlock(&h->lock);
+
+    return rc;
+}
+
+hal_tlsf_heap_t *hal_tlsf_create(void *mem, size_t size)
+{
+    tlsf_heap_t *h = (tlsf_heap_t*)(((uintptr_t)mem + TLSF_ALIGN - 1) & -(uintptr_t)TLSF_ALIGN);
+    const size_t hsize = (sizeof(*h) + TLSF_ALIGN - 1) & ~(size_t)(TLSF_ALIGN - 1);
+    const size_t skip = (size_t)((char*)h - (char*)mem) + hsize;
+
+    if (size < skip)
+        return NULL;
+
+    memset(h, 0, sizeof(*h));
+
+    if (tlsf_add_pool(h, (char*)h + hsize, size - skip))
+        return NULL;
+
+    return h;
+}
+
+void *hal_tlsf_heap_memalign(hal_tlsf_heap_t *h, size_t align, size_t size)
+{
+    if (align < TLSF_ALIGN)
+        align = TLSF_ALIGN;
+
+    if ((align & (align - 1)) || size > TLSF_MAX_SIZE / 2 || align > TLSF_MAX_SIZE / 2) {
+        errno = (align & (align - 1)) ? EINVAL : ENOMEM;
+        return NULL;
+    }
+
+    size = tlsf_adjust(size);
+
+    // room for a leading free block in front of the aligned one
+    const size_t search = (align > TLSF_ALIGN) ? size + align + TLSF_HDR + TLSF_MIN_SIZE : size;
+
+    arch_lock(&h->lock);
+
+    tlsf_block_t *b = tlsf_find(h, search);
+
+    if (!b && tlsf_grow(h, size, align))
+        b = tlsf_find(h, search);
+
+    if (!b) {
+        ++h->failures;
+        arch_unlock(&h->lock);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if (align > TLSF_ALIGN) {
+        uintptr_t p = ((uintptr_t)(b + 1) + align - 1) & -(uintptr_t)align;
+        size_t gap = p - (uintptr_t)(b + 1);
+
+        // the gap has to fit a free block
+        if (gap && gap < TLSF_HDR + TLSF_MIN_SIZE) {
+            p += align;
+            gap += align;
+        }
+
+        if (gap) {
+            tlsf_block_t *aligned = tlsf_split(b, gap - TLSF_HDR);
+
+            // b stays a free leading block
+            aligned->size |= TLSF_PREV_FREE;
+            aligned->prev_phys = b;
+            tlsf_insert_free(h, b);
+            b = aligned;
+        }
+    }
+
+    void *ptr = tlsf_use(h, b, size);
+
+    arch_unlock(&h->lock);
+
+    return ptr;
+}
+
+void hal_tlsf_heap_free(hal_tlsf_heap_t *h, void *ptr)
+{
+    if (!ptr)
+        return;
+
+    arch_lock(&h->lock);
+
+    tlsf_check_block(ptr);
+
+    tlsf_block_t *b = tlsf_from_ptr(ptr);
+
+    h->used -= tlsf_size(b) + TLSF_HDR;
+    ++h->frees;
+
+    tlsf_mark(b, true);
+    tlsf_insert_free(h, tlsf_merge(h, b));
+
+    arch_unlock(&h->lock);
+}
+
+void *hal_tlsf_memalign(size_t align, size_t size)
+{
+    return hal_tlsf_heap_memalign(&tlsf_default, align, size);
+}
+
+void *hal_tlsf_malloc(size_t size)
+{
+    return hal_tlsf_heap_memalign(&tlsf_default, TLSF_ALIGN, size);
+}
+
+void *hal_tlsf_calloc(size_t n, size_t size)
+{
+    if (size && n > (size_t)-1 / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    void *p = hal_tlsf_malloc(n * size);
+
+    if (p)
+        memset(p, 0, n * size);
+
+    return p;
+}
+
+void hal_tlsf_free(void *ptr)
+{
+    hal_tlsf_heap_free(&tlsf_default, ptr);
+}
+
+void *hal_tlsf_realloc(void *ptr, size_t size)
+{
+    tlsf_heap_t *h = &tlsf_default;
+
+    if (!ptr)
+        return hal_tlsf_malloc(size);
+
+    if (!size) {
+        hal_tlsf_free(ptr);
+        return NULL;
+    }
+
+    if (size > TLSF_MAX_SIZE / 2) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    const size_t asize = tlsf_adjust(size);
+
+    arch_lock(&h->lock);
+
+    tlsf_check_block(ptr);
+
+    tlsf_block_t *b = tlsf_from_ptr(ptr);
+    const size_t cur = tlsf_size(b);
+    tlsf_block_t *next = tlsf_next_phys(b);
+
+    // in place: shrink or grow into the next free block
+    if (asize <= cur ||
+        ((next->size & TLSF_FREE) && asize <= cur + TLSF_HDR + tlsf_size(next))) {
+        if (asize > cur) {
+            tlsf_remove(h, next);
+            tlsf_absorb(b, next);
+            tlsf_mark(b, false);
+        }
+
+        tlsf_trim_used(h, b, asize);
+
+        h->used += tlsf_size(b);
+        h->used -= cur;
+        if (h->used > h->peak_used)
+            h->peak_used = h->used;
+
+        arch_unlock(&h->lock);
+
+        return ptr;
+    }
+
+    arch_unlock(&h->lock);
+
+    void *p = hal_tlsf_malloc(size);
+
+    if (p) {
+        memcpy(p, ptr, cur);
+        hal_tlsf_free(ptr);
+    }
+
+    return p;
+}
+
+size_t hal_tlsf_usable_size(const void *ptr)
+{
+    return ptr ? tlsf_size(tlsf_from_ptr(ptr)) : 0;
+}
+
+// walks all pools, returns 0 or -EFAULT
+static int tlsf_walk(tlsf_heap_t *h, hal_tlsf_walker_t fn, void *ctx, hal_tlsf_stat_t *stat)
+{
+    for (unsigned i = 0; i < h->pools; ++i) {
+        const tlsf_block_t *b = h->pool[i].first;
+        const char *end = (const char*)b + h->pool[i].size;
+        bool prev_free = false;
+
+        for (;;) {
+            if ((const char*)(b + 1) > end || !!(b->size & TLSF_PREV_FREE) != prev_free)
+                return -EFAULT;
+
+            const size_t size = tlsf_size(b);
+            const bool is_free = !!(b->size & TLSF_FREE);
+
+            // the sentinel
+            if (!size && !is_free) {
+                if ((const char*)(b + 1) != end)
+                    return -EFAULT;
+                break;
+            }
+
+            const tlsf_block_t *next = tlsf_next_phys(b);
+
+            if ((const char*)next >= end || (is_free && next->prev_phys != b))
+                return -EFAULT;
+
+            if (is_free) {
+                unsigned fl, sl;
+
+                // free blocks are merged and listed
+                if (prev_free)
+                    return -EFAULT;
+                tlsf_mapping(size, &fl, &sl);
+                if (!(h->sl_bitmap[fl] & (1U << sl)) || !(h->fl_bitmap & (1U << fl)))
+                    return -EFAULT;
+
+                if (stat) {
+                    stat->free += size;
+                    if (size > stat->max_free_block)
+                        stat->max_free_block = size;
+                }
+            }
+
+            if (fn)
+                fn((void*)(b + 1), size, !is_free, ctx);
+
+            prev_free = is_free;
+            b = next;
+        }
+    }
+
+    return 0;
+}
+
+int hal_tlsf_heap_check(hal_tlsf_heap_t *h)
+{
+    arch_lock(&h->lock);
+    int rc = tlsf_walk(h, NULL, NULL, NULL);
+
+    // list heads are free blocks of the matching size
+    for (unsigned fl = 0; !rc && fl < TLSF_FL_COUNT; ++fl) {
+        for (unsigned sl = 0; sl < TLSF_SL_COUNT; ++sl) {
+            const tlsf_block_t *b = h->blocks[fl][sl];
+            unsigned f, s;
+
+            if (!b != !(h->sl_bitmap[fl] & (1U << sl))) {
+                rc = -EFAULT;
+                break;
+            }
+            if (!b)
+                continue;
+
+            tlsf_mapping(tlsf_size(b), &f, &s);
+            if (!(b->size & TLSF_FREE) || f != fl || s != sl || tlsf_links((tlsf_block_t*)b)->prev) {
+                rc = -EFAULT;
+                break;
+            }
+        }
+    }
+    arch_unlock(&h->lock);
+
+    return rc;
+}
+
+void hal_tlsf_heap_walk(hal_tlsf_heap_t *h, hal_tlsf_walker_t fn, void *ctx)
+{
+    arch_lock(&h->lock);
+    tlsf_walk(h, fn, ctx, NULL);
+    arch_unlock(&h->lock);
+}
+
+void hal_tlsf_heap_get_stat(hal_tlsf_heap_t *h, hal_tlsf_stat_t *stat)
+{
+    memset(stat, 0, sizeof(*stat));
+
+    arch_lock(&h->lock);
+    tlsf_walk(h, NULL, NULL, stat);
+    stat->total = h->total;
+    stat->used = h->used;
+    stat->peak_used = h->peak_used;
+    stat->allocs = h->allocs;
+    stat->frees = h->frees;
+    stat->failures = h->failures;
+    stat->pools = h->pools;
+    arch_unlock(&h->lock);
+}
+
+int hal_tlsf_check(void)
+{
+    return hal_tlsf_heap_check(&tlsf_default);
+}
+
+void hal_tlsf_walk(hal_tlsf_walker_t fn, void *ctx)
+{
+    hal_tlsf_heap_walk(&tlsf_default, fn, ctx);
+}
+
+void hal_tlsf_get_stat(hal_tlsf_stat_t *stat)
+{
+    hal_tlsf_heap_get_stat(&tlsf_default, stat);
+}
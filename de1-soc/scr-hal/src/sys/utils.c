@@ -124,6 +124,13 @@ int hal_get_sysinfo(char* buf, size_t len, bool extended_output)
     const unsigned long cr = rtc_dyn_hart_clock_rate();
     sz += snprintf((buf + sz), (len - sz), "Clock rate:    \t%lu.%03lu MHz\n", cr / 1000000, (cr % 1000000) / 1000);
 
+    /* boot time */
+    sz += snprintf((buf + sz), (len - sz), "Boot cycles:   \tbss complete at %lu (caches init %lu, bss init %lu)\n",
+                   (unsigned long)get_bss_complete_cycles(), (unsigned long)get_boot_cache_init_cycles(),
+                   (unsigned long)get_boot_bss_init_cycles());
+    sz += snprintf((buf + sz), (len - sz), "Boot cycles:   \ttls init %lu, bss wait %lu\n",
+                   (unsigned long)get_boot_tls_init_cycles(), (unsigned long)get_boot_bss_wait_cycles());
+
 #ifdef PLF_CACHE_CFG
     /* L1 cache info block */
 
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Futex-style wait/wake on memory words
+/// Syntacore SCR* infra
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+
+#include "wait.h"
+
+#include "arch.h"
+#include "drivers/cache.h"
+#include "drivers/ipi.h"
+#include "hart_local.h"
+#include "lock.h"
+#include "spin.h"
+
+#include <stdint.h>
+#include <sys/errno.h>
+
+#if (PLF_WAIT_TABLE_SIZE & (PLF_WAIT_TABLE_SIZE - 1)) != 0
+#error PLF_WAIT_TABLE_SIZE must be a power of 2
+#endif
+
+static inline int wait_read(const volatile int *addr)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)addr, sizeof(*addr));
+#else
+    fence();
+#endif // PLF_SMP_NON_COHERENT
+    return *addr;
+}
+
+#ifdef PLF_SMP_SUPPORT
+
+static inline void wait_sync_out(volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_flush((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+static inline void wait_sync_in(volatile void *p, long size)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)p, size);
+#else
+    (void)p;
+    (void)size;
+#endif // PLF_SMP_NON_COHERENT
+}
+
+typedef struct {
+    arch_lock_t lock;
+    unsigned long waiters; // mask of the harts waiting on the bucket
+} __attribute__((aligned(PLF_MAX_CACHELINE_SIZE))) wait_bucket_t;
+
+// updated under the bucket lock
+typedef struct {
+    const volatile int *addr;
+    volatile int woken;
+} __attribute__((aligned(PLF_MAX_CACHELINE_SIZE))) wait_hart_t;
+
+static wait_bucket_t wait_table[PLF_WAIT_TABLE_SIZE];
+static __hart_local wait_hart_t wait_hart;
+
+static inline unsigned wait_self(void)
+{
+    return (unsigned)(arch_hartid() - PLF_SMP_HARTID_BASE);
+}
+
+static inline wait_bucket_t *wait_bucket(const volatile int *addr)
+{
+    const uintptr_t a = (uintptr_t)addr >> 2;
+
+    return &wait_table[(a ^ (a >> 6) ^ (a >> 12)) & (PLF_WAIT_TABLE_SIZE - 1)];
+}
+
+static inline int wait_woken(wait_hart_t *w)
+{
+    wait_sync_in(w, sizeof(*w));
+    return w->woken;
+}
+
+int hal_wait_on(const volatile int *addr, int expected)
+{
+    wait_bucket_t *b = wait_bucket(addr);
+    const unsigned self = wait_self();
+    wait_hart_t *w = hart_local_ptr(wait_hart, self);
+
+    // interrupts stay pending until the hart is registered and asleep
+    const unsigned long mstatus = clear_csr(mstatus, MSTATUS_MIE);
+
+    arch_lock(&b->lock);
+
+    // the waker updates the word before taking the lock: no lost wakeups
+    if (wait_read(addr) != expected) {
+        arch_unlock(&b->lock);
+        set_csr(mstatus, mstatus & MSTATUS_MIE);
+        return -EAGAIN;
+    }
+
+    w->addr = addr;
+    w->woken = 0;
+    wait_sync_out(w, sizeof(*w));
+
+    wait_sync_in(&b->waiters, sizeof(b->waiters));
+    b->waiters |= 1UL << self;
+    wait_sync_out(&b->waiters, sizeof(b->waiters));
+
+    arch_unlock(&b->lock);
+
+#if PLF_IPI_SUPPORT
+#if PLF_IPI_IMSIC
+    const unsigned long ipi_mie = MIE_MEXTERNAL;
+#else
+    const unsigned long ipi_mie = MIE_MSOFTWARE;
+#endif
+    if (read_csr(mie) & ipi_mie) {
+        while (!wait_woken(w)) {
+            wfi();
+            // take the pending IPI
+            set_csr(mstatus, mstatus & MSTATUS_MIE);
+            clear_csr(mstatus, MSTATUS_MIE);
+        }
+    } else
+#endif // PLF_IPI_SUPPORT
+    {
+        arch_spin_until(&arch_spin_site_wait, wait_woken(w));
+    }
+
+    set_csr(mstatus, mstatus & MSTATUS_MIE);
+
+    // acquire barrier
+    __asm__ __volatile__ ("fence r , rw\n" ::: "memory");
+
+    return 0;
+}
+
+unsigned hal_wake(const volatile int *addr, unsigned n)
+{
+    wait_bucket_t *b = wait_bucket(addr);
+    unsigned long wake = 0;
+    unsigned cnt = 0;
+
+    // release barrier: the word update is visible before the waiters are checked
+    fence();
+
+    arch_lock(&b->lock);
+
+    wait_sync_in(&b->waiters, sizeof(b->waiters));
+
+    for (unsigned h = 0; h < PLF_SMP_HART_NUM && cnt < n; ++h) {
+        wait_hart_t *w = hart_local_ptr(wait_hart, h);
+
+        if (!(b->waiters & (1UL << h)))
+            continue;
+
+        wait_sync_in(w, sizeof(*w));
+        if (w->addr != addr)
+            continue;
+
+        w->addr = NULL;
+        w->woken = 1;
+        wait_sync_out(w, sizeof(*w));
+
+        b->waiters &= ~(1UL << h);
+        wake |= 1UL << h;
+        ++cnt;
+    }
+
+    wait_sync_out(&b->waiters, sizeof(b->waiters));
+
+    arch_unlock(&b->lock);
+
+    for (unsigned h = 0; wake; ++h, wake >>= 1) {
+        if (wake & 1)
+            ipi_send(h);
+    }
+
+    return cnt;
+}
+
+#else // PLF_SMP_SUPPORT
+
+// single hart: the word can only be changed by an interrupt handler
+int hal_wait_on(const volatile int *addr, int expected)
+{
+    if (wait_read(addr) != expected)
+        return -EAGAIN;
+
+    arch_spin_until(&arch_spin_site_wait, wait_read(addr) != expected);
+
+    return 0;
+}
+
+unsigned hal_wake(const volatile int *addr, unsigned n)
+{
+    (void)addr;
+    (void)n;
+
+    return 0;
+}
+
+#endif // PLF_SMP_SUPPORT
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2015, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Cache maintenance cost benchmark
+/// Syntacore SCR* infra
+///
+/// Measures HAL cache maintenance operations for a sweep of buffer sizes and
+/// dirtiness levels and prints the results as CSV:
+///     level,op,size,dirty_pct,lines,cycles,cycles_per_line,cycles_per_kb
+/// `cycles` is the minimum over CACHE_BENCH_REPEAT runs.
+/// Whole-cache operations invalidate data of the whole system, so the
+/// benchmark should be run on an otherwise idle cluster.
+///
+/// @copyright Copyright (C) 2015, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#include "arch.h"
+#include "drivers/cache.h"
+#include "utils.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef CACHE_BENCH_MIN_SIZE
+#define CACHE_BENCH_MIN_SIZE (1024)
+#endif
+
+#ifndef CACHE_BENCH_MAX_SIZE
+#define CACHE_BENCH_MAX_SIZE (256 * 1024)
+#endif
+
+#ifndef CACHE_BENCH_REPEAT
+#define CACHE_BENCH_REPEAT (5)
+#endif
+
+// Global L1 invalidation drops dirty lines of the whole hart (stack included)
+// on write-back L1D configurations, so it is measured only on demand
+#ifndef CACHE_BENCH_L1_GLOBAL
+#define CACHE_BENCH_L1_GLOBAL (0)
+#endif
+
+#if PLF_CACHE_CFG
+
+static const unsigned dirty_levels[] = {0, 25, 50, 100};
+
+static void* bench_mem;
+static char* bench_buf;
+static size_t bench_buf_size;
+
+// bring the buffer to the cache and dirty the requested share of lines spread evenly
+static void bench_touch(size_t size, unsigned dirty_pct)
+{
+    const size_t lines = size / PLF_CACHELINE_SIZE;
+
+    for (size_t i = 0; i < lines; ++i)
+        (void)*(volatile char*)(bench_buf + i * PLF_CACHELINE_SIZE);
+
+    for (size_t i = 0; i < lines; ++i) {
+        if ((i * dirty_pct) / 100 != ((i + 1) * dirty_pct) / 100)
+            *(volatile char*)(bench_buf + i * PLF_CACHELINE_SIZE) = (char)i;
+    }
+
+    fence();
+}
+
+static void bench_report(const char* level, const char* op, size_t size, unsigned dirty_pct,
+                         uint64_t cycles)
+{
+    const unsigned long lines = (unsigned long)(size / PLF_CACHELINE_SIZE);
+    // fixed point with 2 decimal digits to not depend on the printf() level
+    const unsigned long per_line = (unsigned long)(cycles * 100 / lines);
+    const unsigned long per_kb = (unsigned long)(cycles * 100 * 1024 / size);
+
+    printf("%s,%s,%lu,%u,%lu,%lu,%lu.%02lu,%lu.%02lu\n", level, op, (unsigned long)size, dirty_pct,
+           lines, (unsigned long)cycles, per_line / 100, per_line % 100, per_kb / 100, per_kb % 100);
+}
+
+#define BENCH_MEASURE(result, prepare, op)             \
+do {                                                   \
+    (result) = UINT64_MAX;                             \
+    for (int __r = 0; __r < CACHE_BENCH_REPEAT; ++__r) { \
+        prepare;                                       \
+        fence();                                       \
+        const uint64_t __start = arch_cycle();         \
+        op;                                            \
+        const uint64_t __cycles = arch_cycle() - __start; \
+        if (__cycles < (result))                       \
+            (result) = __cycles;                       \
+    }                                                  \
+} while (0)
+
+static void bench_l1(size_t size, unsigned dirty_pct)
+{
+    uint64_t cycles;
+
+    BENCH_MEASURE(cycles, bench_touch(size, dirty_pct), cache_l1_flush(bench_buf, (long)size));
+    bench_report("l1", "flush", size, dirty_pct, cycles);
+
+    BENCH_MEASURE(cycles, bench_touch(size, dirty_pct), cache_l1_invalidate(bench_buf, (long)size));
+    bench_report("l1", "invalidate", size, dirty_pct, cycles);
+
+    // cache_memset() uses cbo.zero if Zicboz is supported
+    BENCH_MEASURE(cycles, bench_touch(size, dirty_pct), memset(bench_buf, 0, size));
+    bench_report("l1", "memset_zero", size, dirty_pct, cycles);
+
+    BENCH_MEASURE(cycles, bench_touch(size, dirty_pct), cache_memset(bench_buf, 0, size));
+    bench_report("l1", "cache_memset_zero", size, dirty_pct, cycles);
+
+#if CACHE_BENCH_L1_GLOBAL
+    BENCH_MEASURE(cycles, bench_touch(size, dirty_pct), plf_l1cache_disable(); plf_l1cache_enable());
+    bench_report("l1", "invalidate_all", size, dirty_pct, cycles);
+#endif // CACHE_BENCH_L1_GLOBAL
+}
+
+#if PLF_L2CTL_BASE
+static void bench_l2(size_t size, unsigned dirty_pct)
+{
+    uint64_t cycles;
+
+    if (!plf_l2cache_is_enabled())
+        return;
+
+    // push the dirty lines out of L1 to make them dirty in L2
+    BENCH_MEASURE(cycles, bench_touch(size, dirty_pct); cache_l1_flush(bench_buf, (long)size),
+                  plf_l2cache_disable(); plf_l2cache_enable());
+    bench_report("l2", "flush_invalidate_all", size, dirty_pct, cycles);
+}
+#endif // PLF_L2CTL_BASE
+
+#if PLF_L3CTL_BASE
+static void bench_l3_cmd(unsigned opcode)
+{
+    volatile uint64_t* const l3ctl = (volatile uint64_t*)PLF_L3CTL_BASE;
+    const unsigned banks = (l3ctl[L3C_DESCR_CACHE_IDX] >> 8) & L3C_MASK;
+
+    l3ctl[L3C_CMD_CTRL_IDX] = (L3C_MASK << 8) | opcode;
+
+    for (unsigned b = 0; b < banks; b++)
+        while (!(l3ctl[L3B_STEP * (b + 1) + L3B_CMD_STS] & L3B_CMD_STS_DONE));
+}
+
+// dirty lines reach L3 on L1 flush and L2 flush
+static void bench_l3_prepare(size_t size, unsigned dirty_pct)
+{
+    bench_touch(size, dirty_pct);
+    cache_l1_flush(bench_buf, (long)size);
+#if PLF_L2CTL_BASE
+    plf_l2cache_disable();
+#endif // PLF_L2CTL_BASE
+}
+
+static void bench_l3_finish(void)
+{
+#if PLF_L2CTL_BASE
+    plf_l2cache_enable();
+#endif // PLF_L2CTL_BASE
+}
+
+static void bench_l3(size_t size, unsigned dirty_pct)
+{
+    volatile uint64_t* const l3ctl = (volatile uint64_t*)PLF_L3CTL_BASE;
+    uint64_t cycles;
+
+    if (!l3ctl[L3C_VID_IDX])
+        return;
+
+    BENCH_MEASURE(cycles, bench_l3_prepare(size, dirty_pct), bench_l3_cmd(L3C_CMD_OPCODE_FLUSH));
+    bench_l3_finish();
+    bench_report("l3", "flush_all", size, dirty_pct, cycles);
+
+    // plf_l3cache_init() drops dirty data, so write it back first out of the measurement
+    BENCH_MEASURE(cycles, bench_l3_prepare(size, dirty_pct); bench_l3_cmd(L3C_CMD_OPCODE_CLEAN),
+                  plf_l3cache_init());
+    bench_l3_finish();
+    bench_report("l3", "invalidate_all", size, dirty_pct, cycles);
+}
+#endif // PLF_L3CTL_BASE
+
+int main(void)
+{
+    bench_buf_size = CACHE_BENCH_MAX_SIZE;
+
+    while (bench_buf_size >= CACHE_BENCH_MIN_SIZE) {
+        bench_mem = malloc(bench_buf_size + PLF_CACHELINE_SIZE);
+        if (bench_mem)
+            break;
+        bench_buf_size /= 2;
+    }
+
+    if (!bench_mem) {
+        printf("cache_bench: not enough memory\n");
+        return 1;
+    }
+
+    bench_buf = (char*)(((uintptr_t)bench_mem + PLF_CACHELINE_SIZE - 1) & -(uintptr_t)PLF_CACHELINE_SIZE);
+
+    printf("level,op,size,dirty_pct,lines,cycles,cycles_per_line,cycles_per_kb\n");
+
+    for (size_t size = CACHE_BENCH_MIN_SIZE; size <= bench_buf_size; size *= 2) {
+        for (size_t d = 0; d < ARRAY_SIZE(dirty_levels); ++d) {
+            bench_l1(size, dirty_levels[d]);
+#if PLF_L2CTL_BASE
+            bench_l2(size, dirty_levels[d]);
+#endif // PLF_L2CTL_BASE
+#if PLF_L3CTL_BASE
+            bench_l3(size, dirty_levels[d]);
+#endif // PLF_L3CTL_BASE
+        }
+    }
+
+    free(bench_mem);
+
+    return 0;
+}
+
+#else // PLF_CACHE_CFG
+
+int main(void)
+{
+    printf("cache_bench: platform has no cache\n");
+    return 0;
+}
+
+#endif // PLF_CACHE_CFG
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Fiber switch cost benchmark
+/// Syntacore SCR* infra
+///
+/// The main context and a fiber yield to each other FIBER_BENCH_ITERS times,
+/// `fiber` keeps the FP state clean, `fiber_fp` dirties it before every yield
+/// (FP targets only), `trap` is an ecall round trip through trap_entry for
+/// comparison with a trap based switch. The results are printed as CSV:
+///     switch,iters,cycles_per_switch,stack_used
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#include "arch.h"
+#include "fiber.h"
+#include "drivers/ipi.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef FIBER_BENCH_ITERS
+#define FIBER_BENCH_ITERS (1000)
+#endif
+
+#define BENCH_CAUSE_ECALL_M 11
+
+static volatile double bench_fp_value = 1.0;
+
+static void bench_fiber(void *arg)
+{
+    const int dirty_fp = (int)(uintptr_t)arg;
+
+    for (unsigned i = 0; i < FIBER_BENCH_ITERS; ++i) {
+#if __riscv_flen
+        if (dirty_fp)
+            bench_fp_value = bench_fp_value * 1.0;
+#else
+        (void)dirty_fp;
+#endif
+        hal_fiber_yield();
+    }
+}
+
+static void bench_switch(const char *name, int dirty_fp)
+{
+    hal_fiber_stat_t st0, st1;
+    hal_fiber_t *f = hal_fiber_create(bench_fiber, (void*)(uintptr_t)dirty_fp, 0);
+
+    if (!f) {
+        printf("%s: hal_fiber_create failed\n", name);
+        return;
+    }
+
+    hal_fiber_get_stat(&st0);
+    const uint64_t t0 = arch_cycle();
+    for (unsigned i = 0; i < FIBER_BENCH_ITERS; ++i)
+        hal_fiber_yield();
+    const uint64_t t1 = arch_cycle();
+    hal_fiber_get_stat(&st1);
+
+    const size_t used = hal_fiber_stack_used(f);
+    const int rc = hal_fiber_join(f);
+
+    printf("%s,%u,%lu,%lu%s\n", name, (unsigned)FIBER_BENCH_ITERS,
+           (unsigned long)((t1 - t0) / (st1.switches - st0.switches)),
+           (unsigned long)used, rc ? " (stack guard damaged)" : "");
+}
+
+void trap_handler(unsigned long mcause, unsigned long mepc, unsigned long *frame)
+{
+    if (mcause == BENCH_CAUSE_ECALL_M) {
+        frame[0] = mepc + 4; // resume after ecall
+        return;
+    }
+#if PLF_IPI_SUPPORT
+    if (ipi_trap_handler(mcause))
+        return;
+#endif // PLF_IPI_SUPPORT
+    printf("fiber_bench: unexpected trap, mcause %lx mepc %lx\n", mcause, mepc);
+    abort();
+}
+
+static void bench_trap(void)
+{
+    const uint64_t t0 = arch_cycle();
+
+    for (unsigned i = 0; i < FIBER_BENCH_ITERS; ++i)
+        __asm__ __volatile__ ("ecall" ::: "memory");
+
+    const uint64_t t1 = arch_cycle();
+
+    printf("trap,%u,%lu,0\n", (unsigned)FIBER_BENCH_ITERS,
+           (unsigned long)((t1 - t0) / FIBER_BENCH_ITERS));
+}
+
+int main(void)
+{
+    printf("switch,iters,cycles_per_switch,stack_used\n");
+
+    bench_switch("fiber", 0);
+#if __riscv_flen
+    bench_switch("fiber_fp", 1);
+#endif
+    bench_trap();
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2015, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Lock latency benchmark
+/// Syntacore SCR* infra
+///
+/// All harts repeatedly acquire and release the same lock and increment
+/// a shared counter in the critical section; the results are printed as CSV:
+///     lock,harts,iters,cycles_per_op,max_hart_cycles_per_op
+/// `arch_lock` is the platform lock (AMO based or the flag-based lock when
+/// AMO is not available), `iccm_lock` is the ICCM message based lock.
+/// The master hart serves as the ICCM lock arbiter.
+///
+/// @copyright Copyright (C) 2015, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#include "arch.h"
+#include "barrier.h"
+#include "iccm_lock.h"
+#include "lock.h"
+#include "drivers/cache.h"
+#include "drivers/ipi.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef LOCK_BENCH_ITERS
+#define LOCK_BENCH_ITERS (1000)
+#endif
+
+#if PLF_SMP_SUPPORT
+
+enum { BENCH_ARCH_LOCK, BENCH_ICCM_LOCK, BENCH_NUM };
+
+static const char *const bench_names[BENCH_NUM] = {"arch_lock", "iccm_lock"};
+
+static arch_lock_t bench_arch_lock = ARCH_LOCK_INIT(0);
+static arch_iccm_lock_t bench_iccm_lock = ARCH_ICCM_LOCK_INIT(0);
+static arch_dbarrier_t bench_barrier = ARCH_DBARRIER_INIT(PLF_SMP_HART_NUM);
+
+static struct {
+    volatile unsigned long value;
+} __attribute__((aligned(PLF_MAX_CACHELINE_SIZE))) bench_counter;
+
+static struct {
+    uint64_t cycles[BENCH_NUM];
+} __attribute__((aligned(PLF_MAX_CACHELINE_SIZE))) bench_result[PLF_SMP_HART_NUM];
+
+static void bench_critical(void)
+{
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate((void*)&bench_counter, sizeof(bench_counter));
+#endif
+    bench_counter.value = bench_counter.value + 1;
+#if PLF_SMP_NON_COHERENT
+    cache_l1_flush((void*)&bench_counter, sizeof(bench_counter));
+#endif
+}
+
+static uint64_t bench_run(unsigned kind)
+{
+    const uint64_t t0 = arch_cycle();
+
+    for (unsigned i = 0; i < LOCK_BENCH_ITERS; ++i) {
+        if (kind == BENCH_ARCH_LOCK) {
+            arch_lock(&bench_arch_lock);
+            bench_critical();
+            arch_unlock(&bench_arch_lock);
+        } else {
+            arch_iccm_lock(&bench_iccm_lock);
+            bench_critical();
+            arch_iccm_unlock(&bench_iccm_lock);
+        }
+    }
+
+    return arch_cycle() - t0;
+}
+
+static void bench_hart(void)
+{
+    const unsigned self = (unsigned)(arch_hartid() - PLF_SMP_HARTID_BASE);
+
+    ipi_init();
+
+    for (unsigned kind = 0; kind < BENCH_NUM; ++kind) {
+        arch_dbarrier_wait(&bench_barrier);
+        bench_result[self].cycles[kind] = bench_run(kind);
+#if PLF_SMP_NON_COHERENT
+        cache_l1_flush(&bench_result[self], sizeof(bench_result[self]));
+#endif
+    }
+
+    arch_dbarrier_wait(&bench_barrier);
+}
+
+void smp_slave_entry(void)
+{
+    bench_hart();
+}
+
+int main(void)
+{
+    bench_hart();
+
+#if PLF_SMP_NON_COHERENT
+    cache_l1_invalidate(bench_result, sizeof(bench_result));
+#endif
+
+    printf("lock,harts,iters,cycles_per_op,max_hart_cycles_per_op\n");
+
+    for (unsigned kind = 0; kind < BENCH_NUM; ++kind) {
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        for (unsigned h = 0; h < PLF_SMP_HART_NUM; ++h) {
+            sum += bench_result[h].cycles[kind];
+            if (bench_result[h].cycles[kind] > max)
+                max = bench_result[h].cycles[kind];
+        }
+
+        printf("%s,%u,%u,%lu,%lu\n", bench_names[kind], (unsigned)PLF_SMP_HART_NUM, (unsigned)LOCK_BENCH_ITERS,
+               (unsigned long)(sum / ((uint64_t)PLF_SMP_HART_NUM * LOCK_BENCH_ITERS)),
+               (unsigned long)(max / LOCK_BENCH_ITERS));
+    }
+
+    return 0;
+}
+
+#else // PLF_SMP_SUPPORT
+
+int main(void)
+{
+    printf("lock_bench: SMP is not supported by the platform\n");
+    return 0;
+}
+
+#endif // PLF_SMP_SUPPORT
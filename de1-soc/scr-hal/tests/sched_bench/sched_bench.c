@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2020, Syntacore Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/// @file
+/// @brief Preemptive scheduler latency benchmark
+/// Syntacore SCR* infra
+///
+/// Two threads of the same priority share the hart by time slices (one spins, the
+/// other yields), a high priority thread wakes up SCHED_BENCH_ITERS times with
+/// SCHED_BENCH_PERIOD_US period and preempts them. The results are printed as CSV:
+///     switches,preemptions,ticks,switch_min,switch_avg,switch_max,jitter_min,jitter_max,wake_min,wake_max
+/// switch_* - cycles of the scheduler trap handler for a context switch,
+/// jitter_* - timer interrupt lateness, wake_* - sleep deadline to the thread running, mtimer ticks.
+///
+/// @copyright Copyright (C) 2020, Syntacore Ltd.
+/// Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+///     http://www.apache.org/licenses/LICENSE-2.0
+/// Unless required by applicable law or agreed to in writing, software
+/// distributed under the License is distributed on an "AS IS" BASIS,
+/// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+/// See the License for the specific language governing permissions and
+/// limitations under the License.
+
+#include "arch.h"
+#include "sched.h"
+#include "drivers/rtc.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef SCHED_BENCH_ITERS
+#define SCHED_BENCH_ITERS (100)
+#endif
+
+#ifndef SCHED_BENCH_PERIOD_US
+#define SCHED_BENCH_PERIOD_US (500)
+#endif
+
+#define BENCH_PRIO_PERIODIC 0
+#define BENCH_PRIO_MAIN     1
+#define BENCH_PRIO_WORKER   2
+
+static volatile int bench_stop;
+static volatile unsigned long bench_spins[2];
+static sys_tick_t bench_wake_min = ~(sys_tick_t)0;
+static sys_tick_t bench_wake_max;
+
+static void bench_worker(void *arg)
+{
+    const unsigned idx = (unsigned)(uintptr_t)arg;
+
+    while (!bench_stop) {
+        ++bench_spins[idx];
+        if (idx)
+            hal_sched_yield();
+    }
+}
+
+static void bench_periodic(void *arg)
+{
+    sys_tick_t deadline = rtc_now();
+
+    (void)arg;
+    for (unsigned i = 0; i < SCHED_BENCH_ITERS; ++i) {
+        deadline += rtc_us2ticks(SCHED_BENCH_PERIOD_US);
+        hal_sched_sleep_until(deadline);
+
+        const sys_tick_t late = rtc_now() - deadline;
+
+        if (late < bench_wake_min)
+            bench_wake_min = late;
+        if (late > bench_wake_max)
+            bench_wake_max = late;
+    }
+}
+
+int main(void)
+{
+    hal_sched_stat_t st;
+
+    if (hal_sched_start(BENCH_PRIO_MAIN)) {
+        printf("hal_sched_start failed\n");
+        return 1;
+    }
+
+    hal_thread_t *w0 = hal_thread_create(bench_worker, (void*)0, BENCH_PRIO_WORKER, 0);
+    hal_thread_t *w1 = hal_thread_create(bench_worker, (void*)1, BENCH_PRIO_WORKER, 0);
+    hal_thread_t *p = hal_thread_create(bench_periodic, NULL, BENCH_PRIO_PERIODIC, 0);
+
+    if (!w0 || !w1 || !p) {
+        printf("hal_thread_create failed\n");
+        return 1;
+    }
+
+    hal_thread_join(p);
+    bench_stop = 1;
+    hal_thread_join(w0);
+    hal_thread_join(w1);
+    hal_sched_get_stat(&st);
+
+    printf("switches,preemptions,ticks,switch_min,switch_avg,switch_max,jitter_min,jitter_max,wake_min,wake_max\n");
+    printf("%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+           st.switches, st.preemptions, st.ticks,
+           (unsigned long)st.switch_min,
+           (unsigned long)(st.switch_sum / (st.switches ? st.switches : 1)),
+           (unsigned long)st.switch_max,
+           (unsigned long)st.jitter_min, (unsigned long)st.jitter_max,
+           (unsigned long)bench_wake_min, (unsigned long)bench_wake_max);
+    printf("spins: %lu (spinning) %lu (yielding)\n", bench_spins[0], bench_spins[1]);
+
+    return 0;
+}